@@ -1,4 +1,4 @@
 #!/bin/bash
 MODE=DEBUG
 BUILD_DIR=Debug
-cmake -E make_directory ${BUILD_DIR} && cmake -E chdir ${BUILD_DIR} cmake .. -DCMAKE_BUILD_TYPE=${MODE} && cmake --build ${BUILD_DIR} -- -j3 && ${BUILD_DIR}/cimm_test
+cmake -E make_directory ${BUILD_DIR} && cmake -E chdir ${BUILD_DIR} cmake .. -DCMAKE_BUILD_TYPE=${MODE} && cmake --build ${BUILD_DIR} -- -j3 && ${BUILD_DIR}/cimm_test && ${BUILD_DIR}/cimm_test --engine=compile && ${BUILD_DIR}/cimm_test --engine=vm
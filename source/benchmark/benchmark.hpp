@@ -0,0 +1,79 @@
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace cimm
+{
+namespace benchmark
+{
+
+struct allocation_stats
+{
+    std::size_t count, live_bytes;
+};
+
+auto allocations() -> allocation_stats;
+
+using benchmark_function = void(*)();
+
+inline auto registered() -> std::vector<std::pair<const char *, benchmark_function>>&
+{
+    static std::vector<std::pair<const char *, benchmark_function>> benchmarks;
+    return benchmarks;
+}
+
+struct registration
+{
+    registration(const char *name, benchmark_function f)
+    {
+        registered().emplace_back(name, f);
+    }
+};
+
+inline void report(const std::string& name, double value, const std::string& unit)
+{
+    std::cout << "  " << std::left << std::setw(48) << name << std::right << std::setw(14) << std::fixed << std::setprecision(2) << value << ' ' << unit << std::endl;
+}
+
+template <typename F>
+void measure(const std::string& name, std::size_t iterations, std::size_t items_per_iteration, F&& f)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (std::size_t i = 0; i < iterations; ++i)
+        f();
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    report(name, elapsed.count() / iterations / items_per_iteration, items_per_iteration == 1 ? "ns/op" : "ns/item");
+}
+
+template <typename F>
+void measure(const std::string& name, std::size_t iterations, F&& f)
+{
+    measure(name, iterations, 1, std::forward<F>(f));
+}
+
+template <typename F>
+auto bytes_retained_by(F&& f)
+{
+    auto before = allocations().live_bytes;
+    auto result = f();
+    return std::make_pair(allocations().live_bytes - before, std::move(result));
+}
+
+template <typename T>
+void do_not_optimize(const T& value)
+{
+    asm volatile("" : : "r"(&value) : "memory");
+}
+
+}
+}
+
+#define CIMM_BENCHMARK(name) \
+    static void name(); \
+    static ::cimm::benchmark::registration name##_registration{#name, name}; \
+    static void name()
@@ -0,0 +1,45 @@
+#include "benchmark.hpp"
+#include <cimm/bytecode.hpp>
+#include <cimm/compile.hpp>
+#include <cimm/default_environment.hpp>
+#include <cimm/eval.hpp>
+#include <cimm/parse.hpp>
+
+namespace cimm
+{
+
+namespace
+{
+
+using engine_function = expression(*)(environment&, const expression&);
+
+const std::pair<const char *, engine_function> engines[] = {
+    {"eval", evaluate_expression},
+    {"compile", evaluate_compiled},
+    {"vm", evaluate_bytecode}
+};
+
+void measure_program(const std::string& name, std::size_t iterations, const std::string& definitions, const std::string& program)
+{
+    for (auto& engine : engines)
+    {
+        auto env = create_default_environment();
+        for (auto& definition : parse_expressions(definitions))
+            engine.second(env, definition);
+        auto expr = parse_expression(program);
+        benchmark::measure(name + " (" + engine.first + ")", iterations, [&] { benchmark::do_not_optimize(engine.second(env, expr)); });
+    }
+}
+
+}
+
+CIMM_BENCHMARK(evaluation)
+{
+    measure_program("fib 20", 3, "(def fib (fn [n] (if (< n 2) n (+ (fib (- n 1)) (fib (- n 2))))))", "(fib 20)");
+    measure_program("count to 100000", 3, "", "(loop [i 0] (if (< i 100000) (recur (+ i 1)) i))");
+    measure_program("sum of squares to 100000", 3, "", "(loop [i 0 s 0] (if (< i 100000) (recur (+ i 1) (+ s (* i i))) s))");
+    measure_program("conj 10000 onto a vector", 3, "", "(loop [v [] i 0] (if (< i 10000) (recur (conj v i) (+ i 1)) (count v)))");
+    measure_program("cons 10000 onto a list", 3, "", "(loop [l '() i 0] (if (< i 10000) (recur (cons i l) (+ i 1)) (count l)))");
+}
+
+}
@@ -0,0 +1,111 @@
+#include "benchmark.hpp"
+#include <cimm/expression.hpp>
+#include <algorithm>
+
+namespace cimm
+{
+
+namespace
+{
+
+auto make_hash_map(integer n)
+{
+    hash_map m;
+    for (integer i = 0; i < n; ++i)
+        m = assoc(m, i, i);
+    return m;
+}
+
+}
+
+CIMM_BENCHMARK(hash_map_operations)
+{
+    for (integer n : {32, 1024, 100000})
+    {
+        auto iterations = 2000000 / n;
+        benchmark::measure("assoc " + std::to_string(n) + " integers", iterations, n, [&]
+        {
+            benchmark::do_not_optimize(make_hash_map(n));
+        });
+
+        auto m = make_hash_map(n);
+        benchmark::measure("get " + std::to_string(n) + " integers", iterations, n, [&]
+        {
+            for (integer i = 0; i < n; ++i)
+                benchmark::do_not_optimize(get(m, i));
+        });
+
+        benchmark::measure("dissoc " + std::to_string(n) + " integers", iterations, n, [&]
+        {
+            auto r = m;
+            for (integer i = 0; i < n; ++i)
+                r = dissoc(r, i);
+            benchmark::do_not_optimize(r);
+        });
+    }
+}
+
+CIMM_BENCHMARK(hash_set_membership)
+{
+    for (integer n : {8, 64, 1024})
+    {
+        hash_set s;
+        std::vector<expression> v;
+        for (integer i = 0; i < n; ++i)
+        {
+            s = conj(s, symbol("s" + std::to_string(i)));
+            v.push_back(symbol("s" + std::to_string(i)));
+        }
+        auto iterations = 2000000 / n;
+        benchmark::measure("contains? in a set of " + std::to_string(n) + " symbols", iterations, n, [&]
+        {
+            for (auto& e : v)
+                benchmark::do_not_optimize(contains(s, e));
+        });
+        benchmark::measure("find in a vector of " + std::to_string(n) + " symbols", iterations, n, [&]
+        {
+            for (auto& e : v)
+                benchmark::do_not_optimize(std::find(v.begin(), v.end(), e));
+        });
+    }
+}
+
+CIMM_BENCHMARK(expression_hash)
+{
+    for (integer n : {16, 1000000})
+    {
+        std::vector<expression> elems;
+        for (integer i = 0; i < n; ++i)
+            elems.push_back(integer(i));
+        vector v(elems);
+        auto iterations = std::max(4, 4000000 / n);
+        benchmark::measure("build and hash a vector of " + std::to_string(n), iterations, [&]
+        {
+            benchmark::do_not_optimize(vector(elems).std_hash());
+        });
+        v.std_hash();
+        benchmark::measure("hash a hashed vector of " + std::to_string(n) + " in a new box", iterations, [&]
+        {
+            benchmark::do_not_optimize(expression(v).std_hash());
+        });
+        benchmark::measure("hash conj onto a hashed vector of " + std::to_string(n), iterations, [&]
+        {
+            benchmark::do_not_optimize(conj(v, integer(-1)).std_hash());
+        });
+    }
+
+    hash_map m;
+    std::vector<expression> keys;
+    for (integer i = 0; i < 1024; ++i)
+    {
+        keys.push_back(vector{integer(i), string("key")});
+        m = assoc(m, keys.back(), integer(i));
+    }
+    benchmark::measure("get 1024 vector keys", 2000, 1024, [&]
+    {
+        for (auto& k : keys)
+            benchmark::do_not_optimize(get(m, k));
+    });
+}
+
+}
@@ -0,0 +1,42 @@
+#include "benchmark.hpp"
+#include <cimm/expression.hpp>
+
+namespace cimm
+{
+
+namespace
+{
+
+const integer num_elements = 10000;
+
+auto make_list(integer n)
+{
+    list l;
+    for (integer i = 0; i < n; ++i)
+        l = cons(i, l);
+    return l;
+}
+
+}
+
+CIMM_BENCHMARK(list_operations)
+{
+    benchmark::measure("cons", 200, num_elements, []
+    {
+        benchmark::do_not_optimize(make_list(num_elements));
+    });
+
+    auto l = make_list(num_elements);
+    benchmark::measure("rest", 200, num_elements, [&]
+    {
+        for (auto r = l; !is_empty(r); r = rest(r))
+            benchmark::do_not_optimize(r);
+    });
+
+    benchmark::measure("map", 200, num_elements, [&]
+    {
+        benchmark::do_not_optimize(map(l, [](const expression& e) { return e; }));
+    });
+}
+
+}
@@ -0,0 +1,43 @@
+#include "benchmark.hpp"
+#include <cimm/expression.hpp>
+
+namespace cimm
+{
+
+namespace
+{
+
+const integer num_elements = 100000;
+
+}
+
+CIMM_BENCHMARK(expression_size)
+{
+    benchmark::report("sizeof(expression)", sizeof(expression), "bytes");
+}
+
+CIMM_BENCHMARK(vector_memory_per_element)
+{
+    auto retained = benchmark::bytes_retained_by([]
+    {
+        vector v;
+        for (integer i = 0; i < num_elements; ++i)
+            v = conj(v, i);
+        return v;
+    });
+    benchmark::report("vector of integers", double(retained.first) / num_elements, "bytes/element");
+}
+
+CIMM_BENCHMARK(list_memory_per_element)
+{
+    auto retained = benchmark::bytes_retained_by([]
+    {
+        list l;
+        for (integer i = 0; i < num_elements; ++i)
+            l = cons(i, l);
+        return l;
+    });
+    benchmark::report("list of integers", double(retained.first) / num_elements, "bytes/element");
+}
+
+}
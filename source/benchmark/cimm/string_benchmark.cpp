@@ -0,0 +1,66 @@
+#include "benchmark.hpp"
+#include <cimm/expression.hpp>
+#include <unordered_set>
+#include <vector>
+
+namespace cimm
+{
+
+CIMM_BENCHMARK(string_operations)
+{
+    const int n = 10000;
+    for (std::size_t length : {8, 100})
+    {
+        string s(std::string(length, 'x'));
+        auto suffix = " " + std::to_string(length) + " chars";
+        benchmark::measure("copy" + suffix, 200, n, [&]
+        {
+            std::vector<string> copies(n, s);
+            benchmark::do_not_optimize(copies);
+        });
+        benchmark::measure("hash" + suffix, 200, n, [&]
+        {
+            for (int i = 0; i < n; ++i)
+                benchmark::do_not_optimize(std::hash<string>()(s));
+        });
+        std::unordered_set<string> set{s};
+        benchmark::measure("set lookup" + suffix, 200, n, [&]
+        {
+            for (int i = 0; i < n; ++i)
+                benchmark::do_not_optimize(set.count(s));
+        });
+    }
+
+    benchmark::measure("intern symbol", 200, n, [&]
+    {
+        for (int i = 0; i < n; ++i)
+            benchmark::do_not_optimize(symbol("a-longer-symbol-name"));
+    });
+}
+
+CIMM_BENCHMARK(nested_printing)
+{
+    std::vector<expression> rows;
+    for (integer i = 0; i < 1000; ++i)
+    {
+        std::vector<expression> row;
+        for (integer j = 0; j < 1000; ++j)
+            row.push_back(i * 1000 + j);
+        rows.push_back(vector(row));
+    }
+    expression wide{vector(rows)};
+    benchmark::measure("pr_str of a 1000x1000 nested vector", 3, 1000000, [&]
+    {
+        benchmark::do_not_optimize(pr_str(wide));
+    });
+
+    expression deep{vector{}};
+    for (integer i = 0; i < 1000; ++i)
+        deep = vector{integer(i), deep};
+    benchmark::measure("pr_str of a vector nested 1000 deep", 100, 1000, [&]
+    {
+        benchmark::do_not_optimize(pr_str(deep));
+    });
+}
+
+}
@@ -0,0 +1,132 @@
+#include "benchmark.hpp"
+#include <cimm/expression.hpp>
+#include <cimm/parse.hpp>
+#include <random>
+
+namespace cimm
+{
+
+namespace
+{
+
+template <typename vector_type>
+auto append(std::size_t n)
+{
+    vector_type v;
+    for (std::size_t i = 0; i < n; ++i)
+        v = v.push_back(integer(i));
+    return v;
+}
+
+}
+
+CIMM_BENCHMARK(persistent_vector_append)
+{
+    for (std::size_t n : {32, 1024, 100000, 1000000})
+    {
+        auto iterations = 4000000 / n;
+        benchmark::measure("push_back " + std::to_string(n) + " integers", iterations, n, [&] { benchmark::do_not_optimize(append<persistent_vector<integer>>(n)); });
+        benchmark::measure("push_back " + std::to_string(n) + " expressions", iterations, n, [&] { benchmark::do_not_optimize(append<persistent_vector<expression>>(n)); });
+    }
+}
+
+CIMM_BENCHMARK(transient_vector_append)
+{
+    for (std::size_t n : {1024, 1000000})
+    {
+        auto iterations = 4000000 / n;
+        benchmark::measure("push_back " + std::to_string(n) + " expressions", iterations, n, [&]
+        {
+            transient_vector<expression> t;
+            for (std::size_t i = 0; i < n; ++i)
+                t.push_back(integer(i));
+            benchmark::do_not_optimize(std::move(t).persistent());
+        });
+    }
+}
+
+CIMM_BENCHMARK(vector_construction)
+{
+    for (std::size_t n : {1024, 1000000})
+    {
+        std::vector<expression> elems;
+        for (std::size_t i = 0; i < n; ++i)
+            elems.push_back(integer(i));
+        auto iterations = 4000000 / n;
+        benchmark::measure("vector of " + std::to_string(n) + " from a std::vector", iterations, n, [&] { benchmark::do_not_optimize(vector(elems)); });
+        std::string text = "[";
+        for (std::size_t i = 0; i < n; ++i)
+            text += " " + std::to_string(i);
+        text += "]";
+        benchmark::measure("parse a vector of " + std::to_string(n), iterations / 4 + 1, n, [&] { benchmark::do_not_optimize(parse_expression(text)); });
+    }
+}
+
+CIMM_BENCHMARK(persistent_vector_lookup)
+{
+    for (std::size_t n : {32, 1024, 1000000})
+    {
+        auto v = append<persistent_vector<expression>>(n);
+        std::vector<std::size_t> indices(1000000);
+        std::mt19937 random;
+        for (auto& i : indices)
+            i = std::uniform_int_distribution<std::size_t>(0, n - 1)(random);
+        benchmark::measure("random index into " + std::to_string(n), 10, indices.size(), [&]
+        {
+            for (auto i : indices)
+                benchmark::do_not_optimize(v[i]);
+        });
+        benchmark::measure("iterate over " + std::to_string(n), 10000000 / n, n, [&]
+        {
+            for (auto& e : v)
+                benchmark::do_not_optimize(e);
+        });
+        benchmark::measure("visit chunks of " + std::to_string(n), 10000000 / n, n, [&]
+        {
+            v.for_each_chunk([](auto first, auto last)
+            {
+                for (; first != last; ++first)
+                    benchmark::do_not_optimize(*first);
+            });
+        });
+    }
+}
+
+CIMM_BENCHMARK(vector_scan)
+{
+    const integer n = 100000;
+    auto v = map(vector(append<persistent_vector<expression>>(n)), [](auto& e) { return e; });
+    auto copy = map(v, [](auto& e) { return e; });
+    benchmark::measure("map over 100000", 20, n, [&] { benchmark::do_not_optimize(map(v, [](auto& e) { return e; })); });
+    benchmark::measure("compare 100000 with a copy", 20, n, [&] { benchmark::do_not_optimize(v == copy); });
+    benchmark::measure("compare 100000 with itself", 20, n, [&] { benchmark::do_not_optimize(v == v); });
+    benchmark::measure("pr_str 100000", 5, n, [&] { benchmark::do_not_optimize(pr_str(v)); });
+}
+
+CIMM_BENCHMARK(vector_slice)
+{
+    const integer n = 100000;
+    auto v = vector(append<persistent_vector<expression>>(n));
+    benchmark::measure("rest of 100000", 100000, [&] { benchmark::do_not_optimize(rest(v)); });
+    benchmark::measure("subvec of 100000", 100000, [&] { benchmark::do_not_optimize(subvec(v, 1000, 90000)); });
+    benchmark::measure("concat two of 100000", 100000, [&] { benchmark::do_not_optimize(concat(v, v)); });
+    benchmark::measure("drop all of 100000 with rest", 1, n, [&]
+    {
+        for (auto r = v; !is_empty(r); r = rest(r))
+            benchmark::do_not_optimize(r);
+    });
+}
+
+CIMM_BENCHMARK(vector_conj)
+{
+    const integer n = 100000;
+    benchmark::measure("conj 100000 integers", 20, n, [&]
+    {
+        vector v;
+        for (integer i = 0; i < n; ++i)
+            v = conj(v, i);
+        benchmark::do_not_optimize(v);
+    });
+}
+
+}
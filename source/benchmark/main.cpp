@@ -0,0 +1,59 @@
+#include "benchmark.hpp"
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <malloc.h>
+#include <new>
+
+namespace
+{
+
+std::atomic<std::size_t> allocation_count{0}, live_bytes{0};
+
+}
+
+void *operator new(std::size_t size)
+{
+    auto p = std::malloc(size);
+    if (!p)
+        throw std::bad_alloc();
+    ++allocation_count;
+    live_bytes += malloc_usable_size(p);
+    return p;
+}
+
+void operator delete(void *p) noexcept
+{
+    if (p)
+        live_bytes -= malloc_usable_size(p);
+    std::free(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept
+{
+    operator delete(p);
+}
+
+namespace cimm
+{
+namespace benchmark
+{
+
+auto allocations() -> allocation_stats
+{
+    return {allocation_count, live_bytes};
+}
+
+}
+}
+
+int main(int argc, char **argv)
+{
+    for (auto& b : cimm::benchmark::registered())
+    {
+        if (argc > 1 && !std::strstr(b.first, argv[1]))
+            continue;
+        std::cout << b.first << std::endl;
+        b.second();
+    }
+}
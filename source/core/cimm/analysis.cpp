@@ -0,0 +1,51 @@
+#include "analysis.hpp"
+#include "type_error.hpp"
+
+namespace cimm
+{
+
+namespace
+{
+
+struct fn_visitor : expression::visitor<std::vector<function::overload>>
+{
+    const list& args;
+    fn_visitor(const list& args) : args(args) { }
+
+    auto operator()(const vector& params) const -> std::vector<function::overload>
+    {
+        return {{params, rest(args)}};
+    }
+
+    auto operator()(const list& ) const -> std::vector<function::overload>
+    {
+        auto defs = args;
+        std::vector<function::overload> overloads;
+        overloads.reserve(count(defs));
+        for (; !is_empty(defs); defs = rest(defs))
+        {
+            auto def = as_list(first(defs));
+            auto params = as_vector(first(def));
+            auto body = rest(def);
+            overloads.push_back({params, body});
+        }
+        return overloads;
+    }
+
+    template <typename other>
+    auto operator()(const other& e) const -> std::vector<function::overload>
+    {
+        throw type_error(e, "a vector");
+    }
+};
+
+}
+
+auto parse_fn_overloads(const list& args) -> std::vector<function::overload>
+{
+    if (is_empty(args))
+        return {};
+    return apply(fn_visitor{args}, first(args));
+}
+
+}
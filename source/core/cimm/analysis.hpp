@@ -0,0 +1,97 @@
+#pragma once
+#include "expression.hpp"
+#include <boost/optional.hpp>
+#include <algorithm>
+#include <vector>
+
+namespace cimm
+{
+
+class locals
+{
+public:
+    struct resolved
+    {
+        enum { global, slot, captured } kind;
+        std::size_t index;
+    };
+
+    struct mark
+    {
+        std::size_t num_bindings, next_slot;
+    };
+
+    using recur_target = boost::optional<std::vector<std::size_t>>;
+
+    explicit locals(locals *parent = nullptr) : parent(parent) { }
+
+    auto allocate_slot() -> std::size_t
+    {
+        auto slot = next_slot++;
+        frame_size = std::max(frame_size, next_slot);
+        return slot;
+    }
+
+    auto bind(const symbol& name, std::size_t slot) -> void
+    {
+        bindings.push_back({name, slot});
+    }
+
+    auto save() const -> mark
+    {
+        return {bindings.size(), next_slot};
+    }
+
+    auto restore(const mark& m) -> void
+    {
+        bindings.resize(m.num_bindings);
+        next_slot = m.next_slot;
+    }
+
+    auto resolve(const symbol& name) -> resolved
+    {
+        auto binding = std::find_if(bindings.rbegin(), bindings.rend(), [&](auto& b) { return b.first == name; });
+        if (binding != bindings.rend())
+            return {resolved::slot, binding->second};
+        auto captured = std::find_if(captures.begin(), captures.end(), [&](auto& c) { return c.first == name; });
+        if (captured != captures.end())
+            return {resolved::captured, std::size_t(captured - captures.begin())};
+        if (!parent)
+            return {resolved::global, 0};
+        auto outer = parent->resolve(name);
+        if (outer.kind == resolved::global)
+            return outer;
+        captures.push_back({name, outer});
+        return {resolved::captured, captures.size() - 1};
+    }
+
+    auto get_frame_size() const { return frame_size; }
+
+    auto get_recur_target() const -> const recur_target& { return recur; }
+
+    auto set_recur_target(recur_target target) -> recur_target
+    {
+        std::swap(recur, target);
+        return target;
+    }
+
+    auto get_captures() const
+    {
+        std::vector<resolved> r;
+        r.reserve(captures.size());
+        for (auto& c : captures)
+            r.push_back(c.second);
+        return r;
+    }
+
+private:
+    locals *parent;
+    std::vector<std::pair<symbol, std::size_t>> bindings;
+    std::vector<std::pair<symbol, resolved>> captures;
+    std::size_t next_slot = 0, frame_size = 0;
+    recur_target recur;
+};
+
+auto parse_fn_overloads(const list& args) -> std::vector<function::overload>;
+
+}
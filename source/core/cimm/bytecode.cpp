@@ -0,0 +1,397 @@
+#include "bytecode.hpp"
+#include "error.hpp"
+#include <algorithm>
+#include <limits>
+
+namespace cimm
+{
+
+namespace
+{
+
+auto operand(std::size_t n) -> std::uint16_t
+{
+    if (n > std::numeric_limits<std::uint16_t>::max())
+        throw std::length_error("bytecode operand out of range");
+    return static_cast<std::uint16_t>(n);
+}
+
+class chunk_builder
+{
+public:
+    chunk_builder(environment& env, locals& scope) : env(env), scope(scope) { }
+
+    auto emit(opcode op, std::size_t a = 0, std::size_t b = 0, std::size_t c = 0) -> std::size_t
+    {
+        code.code.push_back({op, operand(a), operand(b), operand(c)});
+        return code.code.size() - 1;
+    }
+
+    auto here() const { return code.code.size(); }
+
+    auto patch_a(std::size_t at, std::size_t target) -> void { code.code[at].a = operand(target); }
+    auto patch_b(std::size_t at, std::size_t target) -> void { code.code[at].b = operand(target); }
+
+    auto constant(expression e) -> std::size_t
+    {
+        code.constants.push_back(std::move(e));
+        return code.constants.size() - 1;
+    }
+
+    auto global(const symbol& name) -> std::size_t
+    {
+        auto v = get_var(env, name);
+        auto found = std::find(code.globals.begin(), code.globals.end(), v);
+        if (found != code.globals.end())
+            return found - code.globals.begin();
+        code.globals.push_back(std::move(v));
+        return code.globals.size() - 1;
+    }
+
+    auto function(closure_template f) -> std::size_t
+    {
+        code.functions.push_back(std::move(f));
+        return code.functions.size() - 1;
+    }
+
+    auto follow_jumps(std::size_t at) const -> std::size_t
+    {
+        while (at < code.code.size() && code.code[at].op == opcode::jump)
+            at = code.code[at].a;
+        return at;
+    }
+
+    auto check_recur_exits(std::size_t target) const -> void
+    {
+        for (auto exit : recur.exits)
+            if (follow_jumps(exit) != target)
+                throw recur_error();
+    }
+
+    auto finish() -> chunk
+    {
+        for (std::size_t i = 0; i < code.code.size(); ++i)
+        {
+            auto& in = code.code[i];
+            auto next = follow_jumps(i + 1);
+            if (in.op == opcode::call && next < code.code.size() && code.code[next].op == opcode::return_ && code.code[next].a == in.a)
+                in.op = opcode::tail_call;
+        }
+        code.num_registers = scope.get_frame_size();
+        return std::move(code);
+    }
+
+    struct recur_point
+    {
+        std::size_t start = 0;
+        std::vector<std::size_t> exits;
+    };
+
+    environment& env;
+    locals& scope;
+    recur_point recur;
+
+private:
+    chunk code;
+};
+
+auto compile(const expression& e, std::size_t target, chunk_builder& out) -> void;
+
+auto compile_body(list body, chunk_builder& out) -> void
+{
+    auto result = out.scope.allocate_slot();
+    if (is_empty(body))
+        out.emit(opcode::load_constant, result, out.constant(nil));
+    for (; !is_empty(body); body = rest(body))
+        compile(first(body), result, out);
+    out.emit(opcode::return_, result);
+}
+
+auto compile_overload(const function::overload& o, environment& env, locals& scope) -> bytecode_lambda::overload
+{
+    auto saved = scope.save();
+    std::vector<std::size_t> slots;
+    for (auto& p : o.params)
+    {
+        slots.push_back(scope.allocate_slot());
+        scope.bind(as_symbol(p), slots.back());
+    }
+    auto outer = scope.set_recur_target(std::move(slots));
+    chunk_builder out{env, scope};
+    compile_body(o.body, out);
+    out.check_recur_exits(out.here() - 1);
+    scope.set_recur_target(std::move(outer));
+    scope.restore(saved);
+    return {count(o.params), out.finish()};
+}
+
+auto compile_fn(const list& args, std::size_t target, chunk_builder& out) -> void
+{
+    locals fn_scope{&out.scope};
+    std::vector<bytecode_lambda::overload> overloads;
+    for (auto& o : parse_fn_overloads(args))
+        overloads.push_back(compile_overload(o, out.env, fn_scope));
+    for (auto& o : overloads)
+        o.code.num_registers = fn_scope.get_frame_size();
+    auto code = detail::make_shared<bytecode_lambda>(std::move(overloads));
+    out.emit(opcode::make_closure, target, out.function({std::move(code), fn_scope.get_captures()}));
+}
+
+auto compile_if(const list& args, std::size_t target, chunk_builder& out) -> void
+{
+    if (count(args) < 2 || count(args) > 3)
+        throw arity_error(count(args), "if");
+    compile(first(args), target, out);
+    auto to_else = out.emit(opcode::jump_if_false, target);
+    compile(first(rest(args)), target, out);
+    auto to_end = out.emit(opcode::jump);
+    out.patch_b(to_else, out.here());
+    auto else_ = rest(rest(args));
+    if (is_empty(else_))
+        out.emit(opcode::load_constant, target, out.constant(nil));
+    else
+        compile(first(else_), target, out);
+    out.patch_a(to_end, out.here());
+}
+
+auto compile_def(const list& args, std::size_t target, chunk_builder& out) -> void
+{
+    auto name = out.global(as_symbol(first(args)));
+    out.emit(opcode::check_undefined, name);
+    compile(first(rest(args)), target, out);
+    out.emit(opcode::define, name, target);
+}
+
+auto compile_catch(const list& args, std::size_t target, chunk_builder& out) -> void
+{
+    compile(first(args), target, out);
+    auto to_end = out.emit(opcode::jump_if_not_error, target);
+    auto saved = out.scope.save();
+    auto handler = out.scope.allocate_slot();
+    auto value = out.scope.allocate_slot();
+    compile(first(rest(args)), handler, out);
+    out.emit(opcode::unwrap_error, target);
+    out.emit(opcode::move, value, target);
+    out.emit(opcode::call, target, handler, 1);
+    out.scope.restore(saved);
+    out.patch_b(to_end, out.here());
+}
+
+auto compile_let(const list& args, std::size_t target, chunk_builder& out) -> void
+{
+    auto bindings = as_vector(first(args));
+    if (count(bindings) % 2 != 0)
+        throw let_forms_error();
+
+    auto saved = out.scope.save();
+    std::vector<std::size_t> slots;
+    slots.reserve(count(bindings) / 2);
+    for (auto it = begin(bindings); it != end(bindings); it += 2)
+        slots.push_back(out.scope.allocate_slot());
+    auto slot = slots.begin();
+    for (auto it = begin(bindings); it != end(bindings); it += 2, ++slot)
+        compile(it[1], *slot, out);
+    slot = slots.begin();
+    for (auto it = begin(bindings); it != end(bindings); it += 2, ++slot)
+        out.scope.bind(as_symbol(it[0]), *slot);
+    compile(first(rest(args)), target, out);
+    out.scope.restore(saved);
+}
+
+auto compile_loop(const list& args, std::size_t target, chunk_builder& out) -> void
+{
+    auto bindings = as_vector(first(args));
+    if (count(bindings) % 2 != 0)
+        throw let_forms_error("loop");
+
+    auto saved = out.scope.save();
+    std::vector<std::size_t> slots;
+    slots.reserve(count(bindings) / 2);
+    for (auto it = begin(bindings); it != end(bindings); it += 2)
+        slots.push_back(out.scope.allocate_slot());
+    auto slot = slots.begin();
+    for (auto it = begin(bindings); it != end(bindings); it += 2, ++slot)
+        compile(it[1], *slot, out);
+    slot = slots.begin();
+    for (auto it = begin(bindings); it != end(bindings); it += 2, ++slot)
+        out.scope.bind(as_symbol(it[0]), *slot);
+    auto outer_target = out.scope.set_recur_target(std::move(slots));
+    auto outer = std::move(out.recur);
+    out.recur = {out.here(), {}};
+    compile(first(rest(args)), target, out);
+    out.check_recur_exits(out.here());
+    out.recur = std::move(outer);
+    out.scope.set_recur_target(std::move(outer_target));
+    out.scope.restore(saved);
+}
+
+auto compile_recur(const list& args, chunk_builder& out) -> void
+{
+    if (!out.scope.get_recur_target())
+        throw recur_error();
+    auto targets = *out.scope.get_recur_target();
+    if (count(args) != integer(targets.size()))
+        throw recur_error(targets.size(), count(args));
+
+    auto saved = out.scope.save();
+    std::vector<std::size_t> slots;
+    slots.reserve(targets.size());
+    for (std::size_t i = 0; i < targets.size(); ++i)
+        slots.push_back(out.scope.allocate_slot());
+    auto slot = slots.begin();
+    for (auto a = args; !is_empty(a); a = rest(a), ++slot)
+        compile(first(a), *slot, out);
+    for (std::size_t i = 0; i < targets.size(); ++i)
+        out.emit(opcode::move, targets[i], slots[i]);
+    out.emit(opcode::jump, out.recur.start);
+    out.recur.exits.push_back(out.here());
+    out.scope.restore(saved);
+}
+
+auto compile_defgeneric(const list& args, std::size_t target, chunk_builder& out) -> void
+{
+    out.emit(opcode::define_generic, out.global(as_symbol(first(args))), target);
+}
+
+auto compile_defmethod(const list& args, std::size_t target, chunk_builder& out) -> void
+{
+    auto name = out.global(as_symbol(first(args)));
+    compile_fn(rest(args), target, out);
+    out.emit(opcode::define_method, name, target);
+}
+
+auto compile_call(const list& l, std::size_t target, chunk_builder& out) -> void
+{
+    auto saved = out.scope.save();
+    std::vector<std::size_t> slots;
+    slots.reserve(count(l));
+    for (auto e = l; !is_empty(e); e = rest(e))
+        slots.push_back(out.scope.allocate_slot());
+    auto slot = slots.begin();
+    for (auto e = l; !is_empty(e); e = rest(e), ++slot)
+        compile(first(e), *slot, out);
+    if (slots.empty())
+    {
+        slots.push_back(out.scope.allocate_slot());
+        out.emit(opcode::load_constant, slots.front(), out.constant(nil));
+    }
+    out.emit(opcode::call, target, slots.front(), slots.size() - 1);
+    out.scope.restore(saved);
+}
+
+auto compile(const list& l, std::size_t target, chunk_builder& out) -> void
+{
+    auto name = first(l);
+    auto args = rest(l);
+    if (name == special::quote)
+        out.emit(opcode::load_constant, target, out.constant(first(args)));
+    else if (name == special::def)
+        compile_def(args, target, out);
+    else if (name == special::fn)
+        compile_fn(args, target, out);
+    else if (name == special::if_)
+        compile_if(args, target, out);
+    else if (name == special::catch_)
+        compile_catch(args, target, out);
+    else if (name == special::let)
+        compile_let(args, target, out);
+    else if (name == special::defgeneric)
+        compile_defgeneric(args, target, out);
+    else if (name == special::defmethod)
+        compile_defmethod(args, target, out);
+    else if (name == special::loop)
+        compile_loop(args, target, out);
+    else if (name == special::recur)
+        compile_recur(args, out);
+    else
+        compile_call(l, target, out);
+}
+
+auto compile(const symbol& s, std::size_t target, chunk_builder& out) -> void
+{
+    auto r = out.scope.resolve(s);
+    switch (r.kind)
+    {
+        case locals::resolved::slot:
+            if (r.index != target)
+                out.emit(opcode::move, target, r.index);
+            break;
+        case locals::resolved::captured:
+            out.emit(opcode::load_captured, target, r.index);
+            break;
+        default:
+            out.emit(opcode::load_global, target, out.global(s));
+    }
+}
+
+auto compile(const vector& v, std::size_t target, chunk_builder& out) -> void
+{
+    auto saved = out.scope.save();
+    std::vector<std::size_t> slots;
+    slots.reserve(count(v));
+    for (integer i = 0; i < count(v); ++i)
+        slots.push_back(out.scope.allocate_slot());
+    auto slot = slots.begin();
+    for (auto& e : v)
+        compile(e, *slot++, out);
+    out.emit(opcode::make_vector, target, slots.empty() ? 0 : slots.front(), slots.size());
+    out.scope.restore(saved);
+}
+
+auto compile(const hash_map& m, std::size_t target, chunk_builder& out) -> void
+{
+    auto forms = source_forms(m);
+    auto saved = out.scope.save();
+    std::vector<std::size_t> slots;
+    slots.reserve(count(forms));
+    for (integer i = 0; i < count(forms); ++i)
+        slots.push_back(out.scope.allocate_slot());
+    auto slot = slots.begin();
+    for (auto& e : forms)
+        compile(e, *slot++, out);
+    out.emit(opcode::make_hash_map, target, slots.empty() ? 0 : slots.front(), slots.size());
+    out.scope.restore(saved);
+}
+
+auto compile(const hash_set& s, std::size_t target, chunk_builder& out) -> void
+{
+    auto forms = source_forms(s);
+    auto saved = out.scope.save();
+    std::vector<std::size_t> slots;
+    slots.reserve(count(forms));
+    for (integer i = 0; i < count(forms); ++i)
+        slots.push_back(out.scope.allocate_slot());
+    auto slot = slots.begin();
+    for (auto& e : forms)
+        compile(e, *slot++, out);
+    out.emit(opcode::make_hash_set, target, slots.empty() ? 0 : slots.front(), slots.size());
+    out.scope.restore(saved);
+}
+
+template <typename expression_type>
+auto compile(const expression_type& e, std::size_t target, chunk_builder& out) -> void
+{
+    out.emit(opcode::load_constant, target, out.constant(e));
+}
+
+auto compile(const expression& e, std::size_t target, chunk_builder& out) -> void
+{
+    apply([&](auto& e) { compile(e, target, out); }, e);
+}
+
+}
+
+auto compile_bytecode(environment& env, const expression& expr) -> chunk
+{
+    locals scope;
+    chunk_builder out{env, scope};
+    compile_body(list{expr}, out);
+    return out.finish();
+}
+
+auto evaluate_bytecode(environment& env, const expression& expr) -> expression
+{
+    return execute_bytecode(env, compile_bytecode(env, expr));
+}
+
+}
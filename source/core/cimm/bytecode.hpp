@@ -0,0 +1,77 @@
+#pragma once
+#include "expression.hpp"
+#include "environment.hpp"
+#include "analysis.hpp"
+#include "compile.hpp"
+#include <cstdint>
+
+namespace cimm
+{
+
+enum class opcode : std::uint8_t
+{
+    load_constant,      // r[a] = constants[b]
+    load_global,        // r[a] = value of globals[b]
+    load_captured,      // r[a] = captured[b]
+    move,               // r[a] = r[b]
+    make_vector,        // r[a] = [r[b] ... r[b + c - 1]]
+    make_hash_map,      // r[a] = {r[b] r[b + 1] ... r[b + c - 2] r[b + c - 1]}
+    make_hash_set,      // r[a] = #{r[b] ... r[b + c - 1]}
+    make_closure,       // r[a] = closure over functions[b]
+    call,               // r[a] = (r[b] r[b + 1] ... r[b + c])
+    tail_call,          // return (r[b] r[b + 1] ... r[b + c]), reusing the frame for bytecode closures
+    jump,               // continue at a
+    jump_if_false,      // continue at b if r[a] is false or nil
+    jump_if_not_error,  // continue at b if r[a] is not an error
+    unwrap_error,       // r[a] = unwrapped r[a]
+    check_undefined,    // fail if globals[a] is already defined
+    define,             // define globals[a] as r[b], r[b] = nil
+    define_generic,     // define globals[a] as a generic method unless defined, r[b] = nil
+    define_method,      // add r[b] to generic method globals[a], r[b] = nil
+    return_             // return r[a]
+};
+
+struct instruction
+{
+    opcode op;
+    std::uint16_t a, b, c;
+};
+
+struct closure_template
+{
+    detail::shared_ptr<const lambda> code;
+    std::vector<locals::resolved> captures;
+};
+
+struct chunk
+{
+    std::vector<instruction> code;
+    std::vector<expression> constants;
+    std::vector<var_ptr> globals;
+    std::vector<closure_template> functions;
+    std::size_t num_registers = 0;
+};
+
+class bytecode_lambda : public lambda
+{
+public:
+    struct overload
+    {
+        integer arity;
+        chunk code;
+    };
+
+    bytecode_lambda(std::vector<overload> overloads) : overloads(std::move(overloads)) { }
+
+    auto call(environment& env, const closure& self, const expression *args, integer num_args) const -> expression override;
+    auto find_overload(integer num_args) const -> const overload&;
+
+private:
+    std::vector<overload> overloads;
+};
+
+auto compile_bytecode(environment& env, const expression& expr) -> chunk;
+auto execute_bytecode(environment& env, const chunk& code) -> expression;
+auto evaluate_bytecode(environment& env, const expression& expr) -> expression;
+
+}
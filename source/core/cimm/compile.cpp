@@ -0,0 +1,648 @@
+#include "compile.hpp"
+#include "analysis.hpp"
+#include "eval.hpp"
+#include "default_environment.hpp"
+#include "error.hpp"
+#include "type_error.hpp"
+#include <algorithm>
+
+namespace cimm
+{
+
+namespace
+{
+
+class constant_node : public node
+{
+public:
+    constant_node(expression value) : value(std::move(value)) { }
+    auto execute(environment&, frame&) const -> expression override { return value; }
+private:
+    expression value;
+};
+
+class global_node : public node
+{
+public:
+    global_node(var_ptr v) : v(std::move(v)) { }
+
+    auto execute(environment&, frame&) const -> expression override
+    {
+        return value(*v);
+    }
+
+private:
+    var_ptr v;
+};
+
+class slot_node : public node
+{
+public:
+    slot_node(std::size_t slot) : slot(slot) { }
+    auto execute(environment&, frame& f) const -> expression override { return f.slots[slot]; }
+private:
+    std::size_t slot;
+};
+
+class captured_node : public node
+{
+public:
+    captured_node(std::size_t index) : index(index) { }
+    auto execute(environment&, frame& f) const -> expression override { return f.self->captured[index]; }
+private:
+    std::size_t index;
+};
+
+class vector_node : public node
+{
+public:
+    vector_node(std::vector<node_ptr> elems) : elems(std::move(elems)) { }
+
+    auto execute(environment& env, frame& f) const -> expression override
+    {
+        std::vector<expression> values;
+        values.reserve(elems.size());
+        for (auto& e : elems)
+            values.push_back(e->execute(env, f));
+        return vector{values};
+    }
+
+private:
+    std::vector<node_ptr> elems;
+};
+
+class hash_map_node : public node
+{
+public:
+    hash_map_node(std::vector<node_ptr> elems) : elems(std::move(elems)) { }
+
+    auto execute(environment& env, frame& f) const -> expression override
+    {
+        hash_map m;
+        for (std::size_t i = 0; i < elems.size(); i += 2)
+        {
+            auto key = elems[i]->execute(env, f);
+            m = assoc(m, key, elems[i + 1]->execute(env, f));
+        }
+        return m;
+    }
+
+private:
+    std::vector<node_ptr> elems;
+};
+
+class hash_set_node : public node
+{
+public:
+    hash_set_node(std::vector<node_ptr> elems) : elems(std::move(elems)) { }
+
+    auto execute(environment& env, frame& f) const -> expression override
+    {
+        hash_set s;
+        for (auto& e : elems)
+            s = conj(s, e->execute(env, f));
+        return s;
+    }
+
+private:
+    std::vector<node_ptr> elems;
+};
+
+class if_node : public node
+{
+public:
+    if_node(node_ptr cond, node_ptr then, node_ptr else_) : cond(std::move(cond)), then(std::move(then)), else_(std::move(else_)) { }
+
+    auto execute(environment& env, frame& f) const -> expression override
+    {
+        auto c = cond->execute(env, f);
+        auto is_true = c != false && c != nil;
+        if (is_true)
+            return then->execute(env, f);
+        return else_ ? else_->execute(env, f) : nil;
+    }
+
+    auto execute_tail(environment& env, frame& f, tail_call& tail) const -> expression override
+    {
+        auto c = cond->execute(env, f);
+        auto is_true = c != false && c != nil;
+        if (is_true)
+            return then->execute_tail(env, f, tail);
+        return else_ ? else_->execute_tail(env, f, tail) : nil;
+    }
+
+private:
+    node_ptr cond, then, else_;
+};
+
+class call_node : public node
+{
+public:
+    call_node(node_ptr fn, std::vector<node_ptr> args) : fn(std::move(fn)), args(std::move(args)) { }
+
+    auto execute(environment& env, frame& f) const -> expression override
+    {
+        return evaluate(env, f, nullptr);
+    }
+
+    auto execute_tail(environment& env, frame& f, tail_call& tail) const -> expression override
+    {
+        return evaluate(env, f, &tail);
+    }
+
+private:
+    node_ptr fn;
+    std::vector<node_ptr> args;
+
+    auto evaluate(environment& env, frame& f, tail_call *tail) const -> expression
+    {
+        auto fv = fn->execute(env, f);
+        boost::container::small_vector<expression, 8> values;
+        values.reserve(args.size());
+        for (auto& a : args)
+            values.push_back(a->execute(env, f));
+        if (is_error(fv))
+            return fv;
+        for (auto& v : values)
+            if (is_error(v))
+                return v;
+        expression result;
+        if (try_intrinsic(fv, values.data(), values.size(), result))
+            return result;
+        if (!tail || fv.get_tag() != expression::tag::closure)
+            return call_function(env, fv, values.data(), values.size());
+        tail->kind = tail_call::call;
+        tail->callee = std::move(fv);
+        tail->args = std::move(values);
+        return nil;
+    }
+};
+
+class let_node : public node
+{
+public:
+    let_node(std::vector<std::pair<std::size_t, node_ptr>> bindings, node_ptr body) : bindings(std::move(bindings)), body(std::move(body)) { }
+
+    auto execute(environment& env, frame& f) const -> expression override
+    {
+        for (auto& b : bindings)
+            f.slots[b.first] = b.second->execute(env, f);
+        return body->execute(env, f);
+    }
+
+    auto execute_tail(environment& env, frame& f, tail_call& tail) const -> expression override
+    {
+        for (auto& b : bindings)
+            f.slots[b.first] = b.second->execute(env, f);
+        return body->execute_tail(env, f, tail);
+    }
+
+private:
+    std::vector<std::pair<std::size_t, node_ptr>> bindings;
+    node_ptr body;
+};
+
+class loop_node : public node
+{
+public:
+    loop_node(std::vector<std::pair<std::size_t, node_ptr>> bindings, node_ptr body) : bindings(std::move(bindings)), body(std::move(body)) { }
+
+    auto execute(environment& env, frame& f) const -> expression override
+    {
+        tail_call tail;
+        auto result = execute_tail(env, f, tail);
+        if (tail.kind == tail_call::call)
+            return call_function(env, tail.callee, tail.args.data(), tail.args.size());
+        return result;
+    }
+
+    auto execute_tail(environment& env, frame& f, tail_call& tail) const -> expression override
+    {
+        for (auto& b : bindings)
+            f.slots[b.first] = b.second->execute(env, f);
+        for (;;)
+        {
+            auto result = body->execute_tail(env, f, tail);
+            if (tail.kind != tail_call::recur)
+                return result;
+            tail.kind = tail_call::none;
+        }
+    }
+
+private:
+    std::vector<std::pair<std::size_t, node_ptr>> bindings;
+    node_ptr body;
+};
+
+class recur_node : public node
+{
+public:
+    recur_node(std::vector<std::size_t> slots, std::vector<node_ptr> args) : slots(std::move(slots)), args(std::move(args)) { }
+
+    auto execute(environment&, frame&) const -> expression override
+    {
+        throw recur_error();
+    }
+
+    auto execute_tail(environment& env, frame& f, tail_call& tail) const -> expression override
+    {
+        boost::container::small_vector<expression, 8> values;
+        values.reserve(args.size());
+        for (auto& a : args)
+            values.push_back(a->execute(env, f));
+        for (std::size_t i = 0; i < slots.size(); ++i)
+            f.slots[slots[i]] = std::move(values[i]);
+        tail.kind = tail_call::recur;
+        return nil;
+    }
+
+private:
+    std::vector<std::size_t> slots;
+    std::vector<node_ptr> args;
+};
+
+class compiled_lambda : public lambda
+{
+public:
+    struct overload
+    {
+        integer arity;
+        std::vector<node_ptr> body;
+    };
+
+    compiled_lambda(std::vector<overload> overloads, std::size_t frame_size) : overloads(std::move(overloads)), frame_size(frame_size) { }
+
+    auto call(environment& env, const closure& self, const expression *args, integer num_args) const -> expression override
+    {
+        auto code = this;
+        auto o = &find_overload(num_args);
+        frame f;
+        f.slots.resize(frame_size);
+        f.self = &self;
+        std::copy(args, args + num_args, f.slots.begin());
+        expression callee;
+        for (;;)
+        {
+            node::tail_call tail;
+            auto result = run(env, *o, f, tail);
+            if (tail.kind == node::tail_call::none)
+                return result;
+            callee = std::move(tail.callee);
+            auto& c = as_closure(callee);
+            code = dynamic_cast<const compiled_lambda *>(c.code.get());
+            if (!code)
+                return c.code->call(env, c, tail.args.data(), tail.args.size());
+            o = &code->find_overload(tail.args.size());
+            f.slots.clear();
+            f.slots.resize(code->frame_size);
+            std::move(tail.args.begin(), tail.args.end(), f.slots.begin());
+            f.self = &c;
+        }
+    }
+
+private:
+    std::vector<overload> overloads;
+    std::size_t frame_size;
+
+    auto find_overload(integer num_args) const -> const overload&
+    {
+        auto o = std::find_if(begin(overloads), end(overloads), [&](auto& o) { return o.arity == num_args; });
+        if (o == end(overloads))
+            throw arity_error(num_args, "fn");
+        return *o;
+    }
+
+    static auto run(environment& env, const overload& o, frame& f, node::tail_call& tail) -> expression
+    {
+        if (o.body.empty())
+            return nil;
+        for (;;)
+        {
+            for (auto e = o.body.begin(); e != o.body.end() - 1; ++e)
+                (*e)->execute(env, f);
+            auto result = o.body.back()->execute_tail(env, f, tail);
+            if (tail.kind != node::tail_call::recur)
+                return result;
+            tail.kind = node::tail_call::none;
+        }
+    }
+};
+
+class fn_node : public node
+{
+public:
+    fn_node(detail::shared_ptr<const lambda> code, std::vector<locals::resolved> captures) : code(std::move(code)), captures(std::move(captures)) { }
+
+    auto execute(environment&, frame& f) const -> expression override
+    {
+        closure c{code, {}};
+        c.captured.reserve(captures.size());
+        for (auto& r : captures)
+            c.captured.push_back(r.kind == locals::resolved::slot ? f.slots[r.index] : f.self->captured[r.index]);
+        return c;
+    }
+
+private:
+    detail::shared_ptr<const lambda> code;
+    std::vector<locals::resolved> captures;
+};
+
+class def_node : public node
+{
+public:
+    def_node(var_ptr v, node_ptr value) : v(std::move(v)), value(std::move(value)) { }
+
+    auto execute(environment& env, frame& f) const -> expression override
+    {
+        if (v->is_bound)
+            throw symbol_already_defined(v->name);
+        v->value = value->execute(env, f);
+        v->is_bound = true;
+        return nil;
+    }
+
+private:
+    var_ptr v;
+    node_ptr value;
+};
+
+class catch_node : public node
+{
+public:
+    catch_node(node_ptr expr, node_ptr handler) : expr(std::move(expr)), handler(std::move(handler)) { }
+
+    auto execute(environment& env, frame& f) const -> expression override
+    {
+        auto result = expr->execute(env, f);
+        if (!is_error(result))
+            return result;
+        auto h = handler->execute(env, f);
+        auto value = apply([](auto& e) -> expression { return unwrap_error(e); }, result);
+        return call_function(env, h, &value, 1);
+    }
+
+private:
+    node_ptr expr, handler;
+
+    static auto unwrap_error(const error& e) -> expression { return unwrap(e); }
+
+    template <typename expression_type>
+    static auto unwrap_error(const expression_type& e) -> expression { return e; }
+};
+
+class defgeneric_node : public node
+{
+public:
+    defgeneric_node(var_ptr v) : v(std::move(v)) { }
+
+    auto execute(environment&, frame&) const -> expression override
+    {
+        if (!v->is_bound)
+        {
+            v->value = generic_method(v->name);
+            v->is_bound = true;
+        }
+        return nil;
+    }
+
+private:
+    var_ptr v;
+};
+
+class defmethod_node : public node
+{
+public:
+    defmethod_node(var_ptr v, node_ptr fn) : v(std::move(v)), fn(std::move(fn)) { }
+
+    auto execute(environment& env, frame& f) const -> expression override
+    {
+        if (!v->is_bound)
+            throw undefined_symbol_error(v->name);
+        define_method(as_generic_method(v->value), fn->execute(env, f));
+        return nil;
+    }
+
+private:
+    var_ptr v;
+    node_ptr fn;
+};
+
+auto compile(const expression& e, environment& env, locals& scope) -> node_ptr;
+
+auto compile_overload(const function::overload& o, environment& env, locals& scope) -> compiled_lambda::overload
+{
+    auto& params = o.params;
+    auto body = o.body;
+    auto saved = scope.save();
+    std::vector<std::size_t> slots;
+    for (auto& p : params)
+    {
+        slots.push_back(scope.allocate_slot());
+        scope.bind(as_symbol(p), slots.back());
+    }
+    auto outer = scope.set_recur_target(std::move(slots));
+    std::vector<node_ptr> nodes;
+    for (; !is_empty(body); body = rest(body))
+        nodes.push_back(compile(first(body), env, scope));
+    scope.set_recur_target(std::move(outer));
+    scope.restore(saved);
+    return {count(params), std::move(nodes)};
+}
+
+auto compile_fn(const list& args, environment& env, locals& scope) -> node_ptr
+{
+    locals fn_scope{&scope};
+    std::vector<compiled_lambda::overload> overloads;
+    for (auto& o : parse_fn_overloads(args))
+        overloads.push_back(compile_overload(o, env, fn_scope));
+    auto code = detail::make_shared<compiled_lambda>(std::move(overloads), fn_scope.get_frame_size());
+    return std::make_shared<fn_node>(std::move(code), fn_scope.get_captures());
+}
+
+auto compile_if(const list& args, environment& env, locals& scope) -> node_ptr
+{
+    if (count(args) < 2 || count(args) > 3)
+        throw arity_error(count(args), "if");
+    auto else_ = rest(rest(args));
+    return std::make_shared<if_node>(
+        compile(first(args), env, scope),
+        compile(first(rest(args)), env, scope),
+        is_empty(else_) ? nullptr : compile(first(else_), env, scope));
+}
+
+auto compile_let(const list& args, environment& env, locals& scope) -> node_ptr
+{
+    auto bindings = as_vector(first(args));
+    if (count(bindings) % 2 != 0)
+        throw let_forms_error();
+
+    auto saved = scope.save();
+    std::vector<std::pair<std::size_t, node_ptr>> compiled;
+    compiled.reserve(count(bindings) / 2);
+    for (auto it = begin(bindings); it != end(bindings); it += 2)
+        compiled.push_back({scope.allocate_slot(), compile(it[1], env, scope)});
+    auto slot = compiled.begin();
+    for (auto it = begin(bindings); it != end(bindings); it += 2, ++slot)
+        scope.bind(as_symbol(it[0]), slot->first);
+    auto body = compile(first(rest(args)), env, scope);
+    scope.restore(saved);
+    return std::make_shared<let_node>(std::move(compiled), std::move(body));
+}
+
+auto compile_loop(const list& args, environment& env, locals& scope) -> node_ptr
+{
+    auto bindings = as_vector(first(args));
+    if (count(bindings) % 2 != 0)
+        throw let_forms_error("loop");
+
+    auto saved = scope.save();
+    std::vector<std::pair<std::size_t, node_ptr>> compiled;
+    std::vector<std::size_t> slots;
+    compiled.reserve(count(bindings) / 2);
+    for (auto it = begin(bindings); it != end(bindings); it += 2)
+    {
+        slots.push_back(scope.allocate_slot());
+        compiled.push_back({slots.back(), compile(it[1], env, scope)});
+    }
+    auto slot = slots.begin();
+    for (auto it = begin(bindings); it != end(bindings); it += 2, ++slot)
+        scope.bind(as_symbol(it[0]), *slot);
+    auto outer = scope.set_recur_target(std::move(slots));
+    auto body = compile(first(rest(args)), env, scope);
+    scope.set_recur_target(std::move(outer));
+    scope.restore(saved);
+    return std::make_shared<loop_node>(std::move(compiled), std::move(body));
+}
+
+auto compile_recur(const list& args, environment& env, locals& scope) -> node_ptr
+{
+    auto& target = scope.get_recur_target();
+    if (!target)
+        throw recur_error();
+    if (count(args) != integer(target->size()))
+        throw recur_error(target->size(), count(args));
+    std::vector<node_ptr> values;
+    values.reserve(count(args));
+    for (auto a = args; !is_empty(a); a = rest(a))
+        values.push_back(compile(first(a), env, scope));
+    return std::make_shared<recur_node>(*target, std::move(values));
+}
+
+auto compile_call(const list& l, environment& env, locals& scope) -> node_ptr
+{
+    auto fn = compile(first(l), env, scope);
+    std::vector<node_ptr> args;
+    args.reserve(count(l));
+    for (auto a = rest(l); !is_empty(a); a = rest(a))
+        args.push_back(compile(first(a), env, scope));
+    return std::make_shared<call_node>(std::move(fn), std::move(args));
+}
+
+auto compile(const list& l, environment& env, locals& scope) -> node_ptr
+{
+    auto name = first(l);
+    auto args = rest(l);
+    if (name == special::quote)
+        return std::make_shared<constant_node>(first(args));
+    if (name == special::def)
+        return std::make_shared<def_node>(get_var(env, as_symbol(first(args))), compile(first(rest(args)), env, scope));
+    if (name == special::fn)
+        return compile_fn(args, env, scope);
+    if (name == special::if_)
+        return compile_if(args, env, scope);
+    if (name == special::catch_)
+        return std::make_shared<catch_node>(compile(first(args), env, scope), compile(first(rest(args)), env, scope));
+    if (name == special::let)
+        return compile_let(args, env, scope);
+    if (name == special::defgeneric)
+        return std::make_shared<defgeneric_node>(get_var(env, as_symbol(first(args))));
+    if (name == special::defmethod)
+        return std::make_shared<defmethod_node>(get_var(env, as_symbol(first(args))), compile_fn(rest(args), env, scope));
+    if (name == special::loop)
+        return compile_loop(args, env, scope);
+    if (name == special::recur)
+        return compile_recur(args, env, scope);
+    return compile_call(l, env, scope);
+}
+
+auto compile(const symbol& s, environment& env, locals& scope) -> node_ptr
+{
+    auto r = scope.resolve(s);
+    switch (r.kind)
+    {
+        case locals::resolved::slot: return std::make_shared<slot_node>(r.index);
+        case locals::resolved::captured: return std::make_shared<captured_node>(r.index);
+        default: return std::make_shared<global_node>(get_var(env, s));
+    }
+}
+
+auto compile(const vector& v, environment& env, locals& scope) -> node_ptr
+{
+    std::vector<node_ptr> elems;
+    elems.reserve(count(v));
+    for (auto& e : v)
+        elems.push_back(compile(e, env, scope));
+    return std::make_shared<vector_node>(std::move(elems));
+}
+
+auto compile(const hash_map& m, environment& env, locals& scope) -> node_ptr
+{
+    auto forms = source_forms(m);
+    std::vector<node_ptr> elems;
+    elems.reserve(count(forms));
+    for (auto& e : forms)
+        elems.push_back(compile(e, env, scope));
+    return std::make_shared<hash_map_node>(std::move(elems));
+}
+
+auto compile(const hash_set& s, environment& env, locals& scope) -> node_ptr
+{
+    auto forms = source_forms(s);
+    std::vector<node_ptr> elems;
+    elems.reserve(count(forms));
+    for (auto& e : forms)
+        elems.push_back(compile(e, env, scope));
+    return std::make_shared<hash_set_node>(std::move(elems));
+}
+
+template <typename expression_type>
+auto compile(const expression_type& e, environment&, locals&) -> node_ptr
+{
+    return std::make_shared<constant_node>(e);
+}
+
+auto compile(const expression& e, environment& env, locals& scope) -> node_ptr
+{
+    return apply([&](auto& e) { return compile(e, env, scope); }, e);
+}
+
+}
+
+auto compile_expression(environment& env, const expression& expr) -> compiled_expression
+{
+    locals scope;
+    auto root = compile(expr, env, scope);
+    return {root, scope.get_frame_size()};
+}
+
+auto execute_compiled(environment& env, const compiled_expression& code) -> expression
+{
+    frame f;
+    f.slots.resize(code.frame_size);
+    return code.root->execute(env, f);
+}
+
+auto evaluate_compiled(environment& env, const expression& expr) -> expression
+{
+    return execute_compiled(env, compile_expression(env, expr));
+}
+
+auto call_closure(environment& env, const closure& f, const list& args) -> expression
+{
+    boost::container::small_vector<expression, 8> values;
+    for (auto a = args; !is_empty(a); a = rest(a))
+        values.push_back(first(a));
+    return f.code->call(env, f, values.data(), values.size());
+}
+
+}
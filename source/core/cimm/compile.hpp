@@ -0,0 +1,50 @@
+#pragma once
+#include "expression.hpp"
+#include "environment.hpp"
+#include <boost/container/small_vector.hpp>
+
+namespace cimm
+{
+
+struct frame
+{
+    boost::container::small_vector<expression, 8> slots;
+    const closure *self = nullptr;
+};
+
+class node
+{
+public:
+    struct tail_call
+    {
+        enum { none, call, recur } kind = none;
+        expression callee;
+        boost::container::small_vector<expression, 8> args;
+    };
+
+    virtual ~node() noexcept = default;
+    virtual auto execute(environment& env, frame& f) const -> expression = 0;
+    virtual auto execute_tail(environment& env, frame& f, tail_call&) const -> expression { return execute(env, f); }
+};
+
+using node_ptr = std::shared_ptr<const node>;
+
+class lambda
+{
+public:
+    virtual ~lambda() noexcept = default;
+    virtual auto call(environment& env, const closure& self, const expression *args, integer num_args) const -> expression = 0;
+};
+
+struct compiled_expression
+{
+    node_ptr root;
+    std::size_t frame_size;
+};
+
+auto compile_expression(environment& env, const expression& expr) -> compiled_expression;
+auto execute_compiled(environment& env, const compiled_expression& code) -> expression;
+auto evaluate_compiled(environment& env, const expression& expr) -> expression;
+auto call_closure(environment& env, const closure& f, const list& args) -> expression;
+
+}
@@ -9,66 +9,65 @@ namespace cimm
 namespace
 {
 
-auto add_integers(const list& l) -> expression
+auto add_integers(argument_span args) -> expression
 {
     integer sum{0};
-    for (auto e = l; not is_empty(e); e = rest(e))
-        sum += as_integer(first(e));
+    for (auto& e : args)
+        sum += as_integer(e);
     return sum;
 }
 
-auto multiply_integers(const list& l) -> expression
+auto multiply_integers(argument_span args) -> expression
 {
     integer prod{1};
-    for (auto e = l; not is_empty(e); e = rest(e))
-        prod *= as_integer(first(e));
+    for (auto& e : args)
+        prod *= as_integer(e);
     return prod;
 }
 
-auto subtract_integers(const list& l) -> expression
+auto subtract_integers(argument_span args) -> expression
 {
-    if (is_empty(l))
-        throw arity_error(count(l), "-");
-    if (count(l) == 1)
-        return -as_integer(first(l));
-    integer d = as_integer(first(l));
-    for (auto e = rest(l); not is_empty(e); e = rest(e))
-        d -= as_integer(first(e));
+    if (args.empty())
+        throw arity_error(args.size(), "-");
+    if (args.size() == 1)
+        return -as_integer(args[0]);
+    integer d = as_integer(args[0]);
+    for (auto& e : args.subspan(1))
+        d -= as_integer(e);
     return d;
 }
 
-auto is_equal(const list& l) -> boolean
+auto is_equal(argument_span args) -> boolean
 {
-    if (is_empty(l))
-      throw arity_error(count(l), "=");
-    auto c = first(l);
-    for (auto e = rest(l); not is_empty(e); e = rest(e))
-        if (c != first(e))
+    if (args.empty())
+      throw arity_error(args.size(), "=");
+    for (auto& e : args.subspan(1))
+        if (args[0] != e)
             return false;
     return true;
 }
 
-auto is_equal_f(const list& l) -> expression
+auto is_equal_f(argument_span args) -> expression
 {
-    return is_equal(l);
+    return is_equal(args);
 }
 
-auto is_unequal_f(const list& l) -> expression
+auto is_unequal_f(argument_span args) -> expression
 {
-    return not is_equal(l);
+    return not is_equal(args);
 }
 
-auto is_less_than_f(const list& l) -> expression
+auto is_less_than_f(argument_span args) -> expression
 {
-    auto x = as_integer(first(l));
-    auto it = rest(l);
-    while (not is_empty(it))
+    if (args.empty())
+        throw arity_error(args.size(), "<");
+    auto x = as_integer(args[0]);
+    for (auto& e : args.subspan(1))
     {
-        auto y = as_integer(first(it));
+        auto y = as_integer(e);
         if (not (x < y))
             return false;
         x = y;
-        it = rest(it);
     }
     return true;
 }
@@ -82,9 +81,9 @@ struct visit_not : expression::visitor<boolean>
     boolean operator()(const T& ) const { return false; }
 };
 
-auto not_f(const list& args) -> expression
+auto not_f(argument_span args) -> expression
 {
-    return is_empty(args) || apply(visit_not(), first(args));
+    return args.empty() || apply(visit_not(), args[0]);
 }
 
 struct make_keyword : expression::visitor<expression>
@@ -96,11 +95,11 @@ struct make_keyword : expression::visitor<expression>
     expression operator()(const T& ) const { return nil; }
 };
 
-auto keyword_f(const list& l) -> expression
+auto keyword_f(argument_span args) -> expression
 {
-    if (is_empty(l))
-        throw arity_error(count(l), "keyword");
-    return apply(make_keyword(), first(l));
+    if (args.empty())
+        throw arity_error(args.size(), "keyword");
+    return apply(make_keyword(), args[0]);
 }
 
 struct make_symbol : expression::visitor<expression>
@@ -111,16 +110,16 @@ struct make_symbol : expression::visitor<expression>
     expression operator()(const T& e) const { throw cannot_create_symbol(e); }
 };
 
-auto symbol_f(const list& l) -> expression
+auto symbol_f(argument_span args) -> expression
 {
-    if (is_empty(l))
-        throw arity_error(count(l), "symbol");
-    return apply(make_symbol(), first(l));
+    if (args.empty())
+        throw arity_error(args.size(), "symbol");
+    return apply(make_symbol(), args[0]);
 }
 
-auto list_f(const list& l) -> expression
+auto list_f(argument_span args) -> expression
 {
-    return l;
+    return list(args.begin(), args.end());
 }
 
 namespace
@@ -156,6 +155,8 @@ struct count_visitor : expression::visitor<expression>
 {
     auto operator()(const list& l) -> expression { return count(l); }
     auto operator()(const vector& v) -> expression { return count(v); }
+    auto operator()(const hash_map& m) -> expression { return count(m); }
+    auto operator()(const hash_set& s) -> expression { return count(s); }
     auto operator()(const nil_type&) -> expression { return integer(0); }
 
     template <typename expression_type>
@@ -169,35 +170,148 @@ auto count_f(const expression& c) -> expression
     return apply(count_visitor(), c);
 }
 
-auto cons_f(const list& args) -> expression
+auto cons_f(argument_span args) -> expression
 {
-    if (is_empty(args))
+    if (args.empty())
         return list{nil};
-    auto elem = first(args);
-    auto r = rest(args);
-    if (is_empty(r))
-        return list{elem};
-    return cons(elem, as_list(first(r)));
+    if (args.size() == 1)
+        return list{args[0]};
+    return cons(args[0], as_list(args[1]));
 }
 
-auto conj_f(const list& args) -> expression
+auto conj_f(const expression& coll, const expression& x) -> expression
 {
-    return conj(first(args), first(rest(args)));
+    return conj(coll, x);
 }
 
-auto nth_f(const list& args) -> expression
+auto nth_f(const vector& v, integer index) -> expression
 {
-    return *(begin(as_vector(first(args))) + as_integer(first(rest(args))));
+    if (index < 0 || index >= count(v))
+        throw index_out_of_bounds_error(index, count(v));
+    return *(begin(v) + index);
 }
 
-auto vector_f(const list& args) -> expression
+auto subvec_f(argument_span args) -> expression
+{
+    if (args.size() < 2 || args.size() > 3)
+        throw arity_error(args.size(), "subvec");
+    auto v = as_vector(args[0]);
+    auto first_index = as_integer(args[1]);
+    auto last_index = args.size() == 3 ? as_integer(args[2]) : count(v);
+    if (first_index < 0 || first_index > count(v))
+        throw index_out_of_bounds_error(first_index, count(v));
+    if (last_index < first_index || last_index > count(v))
+        throw index_out_of_bounds_error(last_index, count(v));
+    return subvec(v, first_index, last_index);
+}
+
+auto catvec_f(argument_span args) -> expression
+{
+    vector v;
+    for (auto& e : args)
+        v = concat(v, as_vector(e));
+    return v;
+}
+
+auto vector_f(argument_span args) -> expression
+{
+    return vector(args.begin(), args.end());
+}
+
+auto vec_f(const list& l) -> vector
+{
+    return vector(l);
+}
+
+auto hash_map_f(argument_span args) -> expression
+{
+    if (args.size() % 2 != 0)
+        throw arity_error(args.size(), "hash-map");
+    hash_map m;
+    for (integer i = 0; i < args.size(); i += 2)
+        m = assoc(m, args[i], args[i + 1]);
+    return m;
+}
+
+auto as_hash_map_or_empty(const expression& e) -> hash_map
+{
+    return e == nil ? hash_map{} : as_hash_map(e);
+}
+
+auto assoc_f(argument_span args) -> expression
+{
+    if (args.size() < 3 || args.size() % 2 == 0)
+        throw arity_error(args.size(), "assoc");
+    auto m = as_hash_map_or_empty(args[0]);
+    for (integer i = 1; i < args.size(); i += 2)
+        m = assoc(m, args[i], args[i + 1]);
+    return m;
+}
+
+auto dissoc_f(argument_span args) -> expression
+{
+    if (args.empty())
+        throw arity_error(args.size(), "dissoc");
+    if (args[0] == nil)
+        return nil;
+    auto m = as_hash_map(args[0]);
+    for (auto& k : args.subspan(1))
+        m = dissoc(m, k);
+    return m;
+}
+
+auto get_f(argument_span args) -> expression
 {
-    return vector(args);
+    if (args.size() < 2 || args.size() > 3)
+        throw arity_error(args.size(), "get");
+    auto not_found = args.size() == 3 ? args[2] : nil;
+    if (args[0] == nil)
+        return not_found;
+    auto found = get(as_hash_map(args[0]), args[1]);
+    return found ? *found : not_found;
 }
 
-auto vec_f(const list& args) -> expression
+auto hash_set_f(argument_span args) -> expression
 {
-    return vector(as_list(first(args)));
+    hash_set s;
+    for (auto& e : args)
+        s = conj(s, e);
+    return s;
+}
+
+auto disj_f(argument_span args) -> expression
+{
+    if (args.empty())
+        throw arity_error(args.size(), "disj");
+    if (args[0] == nil)
+        return nil;
+    auto s = as_hash_set(args[0]);
+    for (auto& k : args.subspan(1))
+        s = disj(s, k);
+    return s;
+}
+
+namespace
+{
+
+struct contains_visitor : expression::visitor<expression>
+{
+    const expression& key;
+    contains_visitor(const expression& key) : key(key) { }
+
+    auto operator()(const hash_set& s) -> expression { return contains(s, key); }
+    auto operator()(const hash_map& m) -> expression { return contains(m, key); }
+    auto operator()(const nil_type&) -> expression { return false; }
+
+    template <typename expression_type>
+    auto operator()(const expression_type& e) -> expression { throw type_error(e, "a set or a map"); }
+};
+
+}
+
+auto contains_f(const expression& coll, const expression& key) -> expression
+{
+    return apply(contains_visitor(key), coll);
 }
 
 auto throw_f(const expression& e) -> expression
@@ -205,29 +319,29 @@ auto throw_f(const expression& e) -> expression
     return error{e};
 }
 
-auto str_f(const list& args) -> expression
+auto str_f(argument_span args) -> expression
 {
-    std::string s;
-    for (auto l = args; not is_empty(l); l = rest(l))
-        s += str(first(l)).c_str();
-    return string{s};
+    string_builder out;
+    for (auto& e : args)
+        str(out, e);
+    return out.str();
 }
 
-auto pr_str_f(const list& args) -> expression
+auto pr_str_f(argument_span args) -> expression
 {
-    std::string s;
-    for (auto l = args; not is_empty(l); l = rest(l))
-        s += pr_str(first(l)).c_str();
-    return string{s};
+    string_builder out;
+    for (auto& e : args)
+        pr_str(out, e);
+    return out.str();
 }
 
-auto print_f(const list& args) -> expression
+auto print_f(argument_span args) -> expression
 {
-    if (is_empty(args))
+    if (args.empty())
         return nil;
-    std::cout << str(first(args));
-    for (auto l = rest(args); not is_empty(l); l = rest(l))
-        std::cout << ' ' << str(first(l));
+    std::cout << str(args[0]);
+    for (auto& e : args.subspan(1))
+        std::cout << ' ' << str(e);
     std::cout << std::flush;
     return nil;
 }
@@ -243,12 +357,12 @@ auto create_default_environment() -> environment
 {
     environment env;
 
-    define_native_function(env, {"+", add_integers});
-    define_native_function(env, {"*", multiply_integers});
-    define_native_function(env, {"-", subtract_integers});
+    define_native_function(env, {"+", add_integers, intrinsic::add});
+    define_native_function(env, {"*", multiply_integers, intrinsic::multiply});
+    define_native_function(env, {"-", subtract_integers, intrinsic::subtract});
     define_native_function(env, {"=", is_equal_f});
     define_native_function(env, {"not=", is_unequal_f});
-    define_native_function(env, {"<", is_less_than_f});
+    define_native_function(env, {"<", is_less_than_f, intrinsic::less_than});
     define_native_function(env, {"not", not_f});
     define_native_function(env, {"keyword", keyword_f});
     define_native_function(env, {"symbol", symbol_f});
@@ -258,9 +372,18 @@ auto create_default_environment() -> environment
     define_native_function(env, {"count", count_f});
     define_native_function(env, {"cons", cons_f});
     define_native_function(env, {"conj", conj_f});
-    define_native_function(env, {"nth", nth_f});
+    define_native_function(env, "nth", nth_f);
     define_native_function(env, {"vector", vector_f});
-    define_native_function(env, {"vec", vec_f});
+    define_native_function(env, "vec", vec_f);
+    define_native_function(env, {"subvec", subvec_f});
+    define_native_function(env, {"catvec", catvec_f});
+    define_native_function(env, {"hash-map", hash_map_f});
+    define_native_function(env, {"assoc", assoc_f});
+    define_native_function(env, {"dissoc", dissoc_f});
+    define_native_function(env, {"get", get_f});
+    define_native_function(env, {"hash-set", hash_set_f});
+    define_native_function(env, {"disj", disj_f});
+    define_native_function(env, {"contains?", contains_f});
     define_native_function(env, {"throw", throw_f});
     define_native_function(env, {"str", str_f});
     define_native_function(env, {"pr-str", pr_str_f});
@@ -270,4 +393,26 @@ auto create_default_environment() -> environment
     return env;
 }
 
+auto try_intrinsic(const expression& fn, const expression *args, integer num_args, expression& result) -> bool
+{
+    if (fn.get_tag() != expression::tag::native_function || num_args < 1 || num_args > 2)
+        return false;
+    auto op = intrinsic_of(as_native_function(fn));
+    if (op == intrinsic::none)
+        return false;
+    for (integer i = 0; i < num_args; ++i)
+        if (args[i].get_tag() != expression::tag::integer)
+            return false;
+    auto x = as_integer(args[0]);
+    switch (op)
+    {
+        case intrinsic::add: result = num_args == 1 ? x : x + as_integer(args[1]); return true;
+        case intrinsic::subtract: result = num_args == 1 ? -x : x - as_integer(args[1]); return true;
+        case intrinsic::multiply: result = num_args == 1 ? x : x * as_integer(args[1]); return true;
+        case intrinsic::less_than: result = num_args == 1 || x < as_integer(args[1]); return true;
+        case intrinsic::none: break;
+    }
+    return false;
+}
+
 }
@@ -5,5 +5,6 @@ namespace cimm
 {
 
 auto create_default_environment() -> environment;
+auto try_intrinsic(const expression& fn, const expression *args, integer num_args, expression& result) -> bool;
 
 }
@@ -1,11 +1,50 @@
 #include "environment.hpp"
+#include "error.hpp"
 
 namespace cimm
 {
 
+auto get_var(environment& env, const symbol& name) -> var_ptr
+{
+    auto& v = env.definitions[name];
+    if (!v)
+        v = std::make_shared<var>(var{name, nil, false});
+    return v;
+}
+
+auto find_var(const environment& env, const symbol& name) -> var *
+{
+    auto found = env.definitions.find(name);
+    return found != env.definitions.end() && found->second->is_bound ? found->second.get() : nullptr;
+}
+
+auto value(const var& v) -> const expression&
+{
+    if (!v.is_bound)
+        throw undefined_symbol_error(v.name);
+    return v.value;
+}
+
+auto define(environment& env, const symbol& name, expression value) -> void
+{
+    auto v = get_var(env, name);
+    if (v->is_bound)
+        throw symbol_already_defined(name);
+    v->value = std::move(value);
+    v->is_bound = true;
+}
+
+auto redefine(environment& env, const symbol& name, expression value) -> void
+{
+    auto v = get_var(env, name);
+    v->value = std::move(value);
+    v->is_bound = true;
+}
+
 auto define_native_function(environment& env, native_function fn) -> void
 {
-    env.definitions.emplace(name(fn), std::move(fn));
+    auto fn_name = symbol(name(fn));
+    redefine(env, fn_name, std::move(fn));
 }
 
 }
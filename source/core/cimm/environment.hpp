@@ -1,15 +1,36 @@
 #pragma once
 #include "expression.hpp"
+#include "native_function.hpp"
 #include <unordered_map>
 
 namespace cimm
 {
 
+struct var
+{
+    symbol name;
+    expression value;
+    bool is_bound = false;
+};
+
+using var_ptr = std::shared_ptr<var>;
+
 struct environment
 {
-    std::unordered_map<string, expression> definitions;
+    std::unordered_map<symbol, var_ptr> definitions;
 };
 
+auto get_var(environment& env, const symbol& name) -> var_ptr;
+auto find_var(const environment& env, const symbol& name) -> var *;
+auto value(const var& v) -> const expression&;
+auto define(environment& env, const symbol& name, expression value) -> void;
+auto redefine(environment& env, const symbol& name, expression value) -> void;
 auto define_native_function(environment& env, native_function fn) -> void;
 
+template <typename F>
+auto define_native_function(environment& env, const string& name, F f) -> void
+{
+    define_native_function(env, make_native_function(name, std::move(f)));
+}
+
 }
@@ -40,8 +40,22 @@ struct call_error : evaluation_error
 
 struct let_forms_error : evaluation_error
 {
-    let_forms_error()
-        : evaluation_error("let requires an even number of forms in binding vector") { }
+    let_forms_error(const string& form = "let")
+        : evaluation_error(form + " requires an even number of forms in binding vector") { }
+};
+
+struct recur_error : evaluation_error
+{
+    recur_error()
+        : evaluation_error("can only recur from tail position") { }
+    recur_error(integer expected, integer n)
+        : evaluation_error("mismatched argument count to recur, expected: " + str(expected) + " args, got: " + str(n)) { }
+};
+
+struct index_out_of_bounds_error : evaluation_error
+{
+    index_out_of_bounds_error(integer index, integer count)
+        : evaluation_error("index " + str(index) + " out of bounds for count " + str(count)) { }
 };
 
 struct no_matching_method_found_error : evaluation_error
@@ -1,6 +1,11 @@
 #include "eval.hpp"
 #include "error.hpp"
 #include "type_error.hpp"
+#include "scope.hpp"
+#include "compile.hpp"
+#include "analysis.hpp"
+#include "default_environment.hpp"
+#include <boost/container/small_vector.hpp>
 
 namespace cimm
 {
@@ -8,83 +13,59 @@ namespace cimm
 namespace
 {
 
+struct tail_call
+{
+    enum { none, call, recur } kind = none;
+    expression callee;
+    scope::values_type args;
+};
+
+auto evaluate_expression(environment& env, const scope_ptr& locals, const expression& expr, tail_call *tail = nullptr) -> expression;
+
 auto evaluate_quote(const list& args)
 {
     return first(args);
 }
 
-auto evaluate_def(environment& env, const list& args) -> expression
+auto evaluate_def(environment& env, const scope_ptr& locals, const list& args) -> expression
 {
-    auto s = first(args);
-    if (env.definitions.count(str(s)) != 0)
-        throw symbol_already_defined(as_symbol(s));
-    env.definitions.emplace(str(s), evaluate_expression(env, first(rest(args))));
+    auto name = as_symbol(first(args));
+    if (find_var(env, name))
+        throw symbol_already_defined(name);
+    define(env, name, evaluate_expression(env, locals, first(rest(args))));
     return nil;
 }
 
-struct fn_visitor : expression::visitor<function>
-{
-    const list& args;
-    fn_visitor(const list& args) : args(args) { }
-
-    auto operator()(const vector& params) const -> function
-    {
-        return function{{{params, rest(args)}}};
-    }
-
-    auto operator()(const list& ) const -> function
-    {
-        auto defs = args;
-        function f;
-        f.overloads.reserve(count(defs));
-        for (; !is_empty(defs); defs = rest(defs))
-        {
-            auto def = as_list(first(defs));
-            auto params = as_vector(first(def));
-            auto body = rest(def);
-            f.overloads.push_back({params, body});
-        }
-        return f;
-    }
-
-    template <typename other>
-    auto operator()(const other& e) const -> function
-    {
-        throw type_error(e, "a vector");
-    }
-};
-
-auto evaluate_fn(environment& env, const list& args) -> function
+auto evaluate_fn(const scope_ptr& locals, const list& args) -> function
 {
-    if (is_empty(args))
-        return function{};
-    return apply(fn_visitor{args}, first(args));
+    return function{parse_fn_overloads(args), locals};
 }
 
-auto evaluate_if(environment& env, const list& args) -> expression
+auto evaluate_if(environment& env, const scope_ptr& locals, const list& args, tail_call *tail) -> expression
 {
     if (count(args) < 2 || count(args) > 3)
         throw arity_error(count(args), "if");
-    auto cond = evaluate_expression(env, first(args));
+    auto cond = evaluate_expression(env, locals, first(args));
     auto is_true = cond != false && cond != nil;
-    return evaluate_expression(env, first(rest(is_true ? args : rest(args))));
+    return evaluate_expression(env, locals, first(rest(is_true ? args : rest(args))), tail);
 }
 
 struct visit_catch : expression::visitor<expression>
 {
     environment& env;
+    const scope_ptr& locals;
     expression handler;
-    visit_catch(environment& env, const expression& handler) : env(env), handler(handler) { }
+    visit_catch(environment& env, const scope_ptr& locals, const expression& handler) : env(env), locals(locals), handler(handler) { }
 
-    auto operator()(const error& e) { return evaluate_expression(env, list{handler, unwrap(e)}); }
+    auto operator()(const error& e) { return evaluate_expression(env, locals, list{handler, unwrap(e)}); }
 
     template <typename expression_type>
     auto operator()(const expression_type& e) { return e; }
 };
 
-auto evaluate_catch(environment& env, const list& args) -> expression
+auto evaluate_catch(environment& env, const scope_ptr& locals, const list& args) -> expression
 {
-    return apply(visit_catch{env, first(rest(args))}, evaluate_expression(env, first(args)));
+    return apply(visit_catch{env, locals, first(rest(args))}, evaluate_expression(env, locals, first(args)));
 }
 
 auto execute(environment&, native_function f, const list& args) -> expression
@@ -92,215 +73,328 @@ auto execute(environment&, native_function f, const list& args) -> expression
     return f(args);
 }
 
-auto replace_symbols(const expression& e, const vector& symbols, const list& values) -> expression;
-
-template <typename expression_type>
-auto replace_symbols(const expression_type& e, const vector&, const list&) -> expression_type
+auto execute(environment& env, const function::overload& overload, const scope_ptr& closure, scope::values_type args, tail_call& tail) -> expression
 {
-    return e;
+    auto locals = make_scope(overload.params, 1, std::move(args), closure);
+    auto body = overload.body;
+    expression result;
+    for (; !is_empty(body); body = rest(body))
+        result = evaluate_expression(env, locals, first(body), is_empty(rest(body)) ? &tail : nullptr);
+    return result;
 }
 
-auto replace_symbols(const symbol& s, const vector& symbols, const list& values) -> expression
+auto execute(environment& env, const function& f, scope::values_type args) -> expression
 {
-    if (is_empty(symbols))
-        return s;
-    if (s == first(symbols))
-        return list{special::quote, first(values)};
-    return replace_symbols(s, rest(symbols), rest(values));
+    auto fn = &f;
+    expression callee;
+    for (;;)
+    {
+        integer num_args = args.size();
+        auto overload = std::find_if(begin(fn->overloads), end(fn->overloads), [&](auto& o) { return count(o.params) == num_args; });
+        if (overload == end(fn->overloads))
+            throw arity_error(num_args, "fn");
+        tail_call tail;
+        auto result = execute(env, *overload, fn->closure, std::move(args), tail);
+        while (tail.kind == tail_call::recur)
+        {
+            if (integer(tail.args.size()) != count(overload->params))
+                throw recur_error(count(overload->params), tail.args.size());
+            auto recur_args = std::move(tail.args);
+            tail = {};
+            result = execute(env, *overload, fn->closure, std::move(recur_args), tail);
+        }
+        if (tail.kind == tail_call::none)
+            return result;
+        callee = std::move(tail.callee);
+        fn = &as_function(callee);
+        args = std::move(tail.args);
+    }
 }
 
-auto replace_symbols(const list& seq, const vector& symbols, const list& values) -> list;
-
-auto replace_symbols(const vector& seq, const vector& symbols, const list& values) -> vector
+auto execute(environment& env, const function& f, const list& args) -> expression
 {
-    return map(seq, [&](auto& e) { return replace_symbols(e, symbols, values); });
+    scope::values_type values;
+    for (auto a = args; !is_empty(a); a = rest(a))
+        values.push_back(first(a));
+    return execute(env, f, std::move(values));
 }
 
-auto remove_params(const vector& v, const vector& forbidden)
+auto execute(environment& env, const closure& f, const list& args) -> expression
 {
-    return map(v, [&](auto& e) { return (std::find(begin(forbidden), end(forbidden), e) == end(forbidden)) ? e : nil; });
+    return call_closure(env, f, args);
 }
 
-auto replace_symbols_fn(const list& seq, const vector& symbols, const list& values) -> list
+auto execute(environment& env, const generic_method& e, const list& args) -> expression
 {
-    auto params = first(rest(seq));
-    return list{special::fn, params, replace_symbols(first(rest(rest(seq))), remove_params(symbols, as_vector(params)), values)};
+    auto methods = get_concrete_methods(e, args);
+    if (methods.empty())
+        throw no_matching_method_found_error(name(e));
+    return call_function(env, methods.front(), args);
 }
 
-auto get_bindings_symbols(const vector& bindings)
+template <typename expression_type>
+auto execute(environment&, const expression_type& e, const list&) -> expression
 {
-    std::vector<expression> symbols;
-    symbols.reserve(count(bindings) / 2);
-    for (auto it = begin(bindings); it != end(bindings); it += 2)
-        symbols.push_back(it[0]);
-    return vector{symbols};
+    throw call_error(e);
 }
 
-auto get_bindings_expressions(const vector& bindings)
+auto find_error(const list& l) -> expression
 {
-    std::vector<expression> expressions;
-    expressions.reserve(count(bindings) / 2);
-    for (auto it = begin(bindings); it != end(bindings); it += 2)
-        expressions.push_back(it[1]);
-    return list{expressions};
+    for (auto it = l; not is_empty(it); it = rest(it))
+        if (is_error(first(it)))
+            return first(it);
+    return nil;
 }
 
-auto replace_symbols_bindings(const vector& bindings, const vector& symbols, const list& values) -> vector
+auto evaluate_native_call(environment& env, const scope_ptr& locals, const expression& callee, const list& args) -> expression
 {
-    std::vector<expression> replaced;
-    replaced.reserve(count(bindings));
-    for (auto it = begin(bindings); it != end(bindings); it += 2)
-    {
-        replaced.push_back(it[0]);
-        replaced.push_back(replace_symbols(it[1], symbols, values));
-    }
-    return vector{replaced};
+    boost::container::small_vector<expression, 8> evaluated;
+    for (auto a = args; !is_empty(a); a = rest(a))
+        evaluated.push_back(evaluate_expression(env, locals, first(a)));
+    for (auto& a : evaluated)
+        if (is_error(a))
+            return a;
+    expression result;
+    if (try_intrinsic(callee, evaluated.data(), evaluated.size(), result))
+        return result;
+    return as_native_function(callee)(evaluated.data(), evaluated.size());
 }
 
-auto replace_symbols_let(const list& seq, const vector& symbols, const list& values) -> list
+auto evaluate_arguments(environment& env, const scope_ptr& locals, const list& args)
 {
-    auto bindings = replace_symbols_bindings(as_vector(first(rest(seq))), symbols, values);
-    auto body = first(rest(rest(seq)));
-
-    return list{special::let, bindings, replace_symbols(body, remove_params(symbols, get_bindings_symbols(bindings)), values)};
+    scope::values_type evaluated;
+    for (auto a = args; !is_empty(a); a = rest(a))
+        evaluated.push_back(evaluate_expression(env, locals, first(a)));
+    return evaluated;
 }
 
-auto replace_symbols(const list& seq, const vector& symbols, const list& values) -> list
+auto evaluate_function_call(environment& env, const scope_ptr& locals, expression callee, const list& args, tail_call *tail) -> expression
 {
-    if (first(seq) == special::fn)
-        return replace_symbols_fn(seq, symbols, values);
-    if (first(seq) == special::let)
-        return replace_symbols_let(seq, symbols, values);
-    if (first(seq) == special::quote)
-        return seq;
-
-    return map(seq, [&](auto const& e) { return replace_symbols(e, symbols, values); });
+    auto evaluated = evaluate_arguments(env, locals, args);
+    for (auto& a : evaluated)
+        if (is_error(a))
+            return a;
+    if (!tail)
+        return execute(env, as_function(callee), std::move(evaluated));
+    tail->kind = tail_call::call;
+    tail->callee = std::move(callee);
+    tail->args = std::move(evaluated);
+    return nil;
 }
 
-auto replace_symbols(const expression& e, const vector& symbols, const list& values) -> expression
+auto evaluate_call(environment& env, const scope_ptr& locals, const list& l, tail_call *tail) -> expression
 {
-    return apply([&](auto& e) -> expression { return replace_symbols(e, symbols, values); }, e);
+    auto callee = evaluate_expression(env, locals, first(l));
+    if (callee.get_tag() == expression::tag::native_function)
+        return evaluate_native_call(env, locals, callee, rest(l));
+    if (callee.get_tag() == expression::tag::function)
+        return evaluate_function_call(env, locals, std::move(callee), rest(l), tail);
+    auto evaluated = cons(callee, map(rest(l), [&](auto const& a) { return evaluate_expression(env, locals, a); }));
+    auto error = find_error(evaluated);
+    if (error != nil)
+        return error;
+    return apply([&](const auto& first) { return execute(env, first, rest(evaluated)); }, callee);
 }
 
-auto execute(environment& env, const function::overload& overload, const list& args) -> expression
+auto evaluate_bindings_expressions(environment& env, const scope_ptr& locals, const vector& bindings)
 {
-    auto body = overload.body;
-    expression result;
-    for (; !is_empty(body); body = rest(body))
-        result = evaluate_expression(env, apply([&](auto& e) -> expression { return replace_symbols(e, overload.params, args); }, first(body)));
-    return result;
+    scope::values_type values;
+    values.reserve(count(bindings) / 2);
+    for (auto it = begin(bindings); it != end(bindings); it += 2)
+        values.push_back(evaluate_expression(env, locals, it[1]));
+    return values;
 }
 
-auto execute(environment& env, const function& f, const list& args) -> expression
+auto evaluate_let(environment& env, const scope_ptr& locals, const list& l, tail_call *tail) -> expression
 {
-    auto overload = std::find_if(begin(f.overloads), end(f.overloads), [&](auto& o) { return count(o.params) == count(args); });
-    if (overload == end(f.overloads))
-        throw arity_error(count(args), "fn");
-    return execute(env, *overload, args);
+    auto bindings = as_vector(first(l));
+    if (count(bindings) % 2 != 0)
+        throw let_forms_error();
+
+    auto values = evaluate_bindings_expressions(env, locals, bindings);
+    return evaluate_expression(env, make_scope(bindings, 2, std::move(values), locals), first(rest(l)), tail);
 }
 
-auto execute(environment& env, const generic_method& e, const list& args) -> expression
+auto evaluate_loop(environment& env, const scope_ptr& locals, const list& l, tail_call *outer) -> expression
 {
-    auto methods = get_concrete_methods(e, args);
-    if (methods.empty())
-        throw no_matching_method_found_error(name(e));
-    return execute(env, methods.front(), args);
+    auto bindings = as_vector(first(l));
+    if (count(bindings) % 2 != 0)
+        throw let_forms_error("loop");
+
+    auto values = evaluate_bindings_expressions(env, locals, bindings);
+    integer num_bindings = values.size();
+    for (;;)
+    {
+        tail_call tail;
+        auto result = evaluate_expression(env, make_scope(bindings, 2, std::move(values), locals), first(rest(l)), &tail);
+        if (tail.kind == tail_call::recur)
+        {
+            if (integer(tail.args.size()) != num_bindings)
+                throw recur_error(num_bindings, tail.args.size());
+            values = std::move(tail.args);
+            continue;
+        }
+        if (tail.kind == tail_call::call && outer)
+            *outer = std::move(tail);
+        else if (tail.kind == tail_call::call)
+            return execute(env, as_function(tail.callee), std::move(tail.args));
+        return result;
+    }
 }
 
-template <typename expression_type>
-auto execute(environment&, const expression_type& e, const list&) -> expression
+auto evaluate_recur(environment& env, const scope_ptr& locals, const list& args, tail_call *tail) -> expression
 {
-    throw call_error(e);
+    if (!tail)
+        throw recur_error();
+    tail->kind = tail_call::recur;
+    tail->args = evaluate_arguments(env, locals, args);
+    return nil;
 }
 
-auto find_error(const list& l) -> expression
+auto evaluate_defgeneric(environment& env, const list& l) -> expression
 {
-    for (auto it = l; not is_empty(it); it = rest(it))
-        if (is_error(first(it)))
-            return first(it);
+    auto name = as_symbol(first(l));
+    if (!find_var(env, name))
+        define(env, name, generic_method(name));
     return nil;
 }
 
-auto evaluate_call(environment& env, const list& l) -> expression
+auto evaluate_defmethod(environment& env, const scope_ptr& locals, const list& l) -> expression
 {
-    auto evaluated = map(l, [&env](auto const& a) { return evaluate_expression(env, a); });
-    auto error = find_error(evaluated);
-    if (error != nil)
-        return error;
-    return apply([&](const auto& first) { return execute(env, first, rest(evaluated)); }, first(evaluated));
+    auto name = as_symbol(first(l));
+    auto m = find_var(env, name);
+    if (!m)
+        throw undefined_symbol_error(name);
+    define_method(as_generic_method(m->value), evaluate_fn(locals, rest(l)));
+    return nil;
 }
 
-auto evaluate_let(environment& env, const list& l) -> expression
+struct form_visitor : expression::visitor<expression>
 {
-    auto bindings = as_vector(first(l));
-    if (count(bindings) % 2 != 0)
-        throw let_forms_error();
+    environment& env;
+    const scope_ptr& locals;
+    const list& l;
+    tail_call *tail;
+    form_visitor(environment& env, const scope_ptr& locals, const list& l, tail_call *tail) : env(env), locals(locals), l(l), tail(tail) { }
+
+    auto operator()(const symbol& name) -> expression
+    {
+        if (name == special::quote)
+            return evaluate_quote(rest(l));
+        if (name == special::def)
+            return evaluate_def(env, locals, rest(l));
+        if (name == special::fn)
+            return evaluate_fn(locals, rest(l));
+        if (name == special::if_)
+            return evaluate_if(env, locals, rest(l), tail);
+        if (name == special::catch_)
+            return evaluate_catch(env, locals, rest(l));
+        if (name == special::let)
+            return evaluate_let(env, locals, rest(l), tail);
+        if (name == special::defgeneric)
+            return evaluate_defgeneric(env, rest(l));
+        if (name == special::defmethod)
+            return evaluate_defmethod(env, locals, rest(l));
+        if (name == special::loop)
+            return evaluate_loop(env, locals, rest(l), tail);
+        if (name == special::recur)
+            return evaluate_recur(env, locals, rest(l), tail);
+        return evaluate_call(env, locals, l, tail);
+    }
 
-    auto evaluated = map(get_bindings_expressions(bindings), [&env](auto const& e) { return evaluate_expression(env, e); });
-    return evaluate_expression(env, replace_symbols(first(rest(l)), get_bindings_symbols(bindings), evaluated));
+    template <typename expression_type>
+    auto operator()(const expression_type& ) -> expression
+    {
+        return evaluate_call(env, locals, l, tail);
+    }
+};
+
+auto evaluate(environment& env, const scope_ptr& locals, const list& l, tail_call *tail) -> expression
+{
+    return apply(form_visitor{env, locals, l, tail}, first(l));
 }
 
-auto evaluate_defgeneric(environment& env, const list& l) -> expression
+auto evaluate(environment& env, const scope_ptr& locals, const symbol& s, tail_call *) -> expression
 {
-    auto name = as_symbol(first(l));
-    env.definitions.insert({str(name), generic_method(name)});
-    return nil;
+    if (auto local = find_local(locals.get(), s))
+        return *local;
+    auto found = find_var(env, s);
+    if (!found)
+        throw undefined_symbol_error(s);
+    return found->value;
 }
 
-auto evaluate_defmethod(environment& env, const list& l) -> expression
+auto evaluate(environment& env, const scope_ptr& locals, const vector& v, tail_call *) -> expression
 {
-    auto name = as_symbol(first(l));
-    auto& m = as_generic_method(env.definitions.find(str(name))->second);
-    define_method(m, evaluate_fn(env, rest(l)));
-    return nil;
+    return map(v, [&](auto& e) { return evaluate_expression(env, locals, e); });
 }
 
-auto evaluate(environment& env, const list& l) -> expression
-{
-    auto name = first(l);
-    if (name == special::quote)
-        return evaluate_quote(rest(l));
-    if (name == special::def)
-        return evaluate_def(env, rest(l));
-    if (name == special::fn)
-        return evaluate_fn(env, rest(l));
-    if (name == special::if_)
-        return evaluate_if(env, rest(l));
-    if (name == special::catch_)
-        return evaluate_catch(env, rest(l));
-    if (name == special::let)
-        return evaluate_let(env, rest(l));
-    if (name == special::defgeneric)
-        return evaluate_defgeneric(env, rest(l));
-    if (name == special::defmethod)
-        return evaluate_defmethod(env, rest(l));
-    return evaluate_call(env, l);
-}
-
-auto evaluate(environment& env, const symbol& s) -> expression
-{
-    auto found = env.definitions.find(str(s));
-    if (found == env.definitions.end())
-        throw undefined_symbol_error(s);
-    return found->second;
+auto evaluate(environment& env, const scope_ptr& locals, const hash_map& m, tail_call *) -> expression
+{
+    hash_map evaluated;
+    auto forms = source_forms(m);
+    for (auto form = begin(forms); form != end(forms); form += 2)
+    {
+        auto key = evaluate_expression(env, locals, *form);
+        evaluated = assoc(evaluated, key, evaluate_expression(env, locals, *(form + 1)));
+    }
+    return evaluated;
 }
 
-auto evaluate(environment& env, const vector& v) -> expression
+auto evaluate(environment& env, const scope_ptr& locals, const hash_set& s, tail_call *) -> expression
 {
-    return map(v, [&](auto& e) { return evaluate_expression(env, e); });
+    hash_set evaluated;
+    for_each(source_forms(s), [&](auto& e) { evaluated = conj(evaluated, evaluate_expression(env, locals, e)); });
+    return evaluated;
 }
 
 template <typename expression_type>
-auto evaluate(environment&, const expression_type& e) -> expression
+auto evaluate(environment&, const scope_ptr&, const expression_type& e, tail_call *) -> expression
 {
     return e;
 }
 
+auto evaluate_expression(environment& env, const scope_ptr& locals, const expression& expr, tail_call *tail) -> expression
+{
+    return apply([&] (auto& e) { return evaluate(env, locals, e, tail); }, expr);
+}
+
 }
 
 auto evaluate_expression(environment& env, const expression& expr) -> expression
 {
-    return apply([&env] (auto& e) { return evaluate(env, e); }, expr);
+    return evaluate_expression(env, nullptr, expr);
+}
+
+auto call_function(environment& env, const expression& f, const list& args) -> expression
+{
+    return apply([&](const auto& f) { return execute(env, f, args); }, f);
+}
+
+namespace
+{
+
+struct call_visitor : expression::visitor<expression>
+{
+    environment& env;
+    const expression& f;
+    const expression *args;
+    integer num_args;
+    call_visitor(environment& env, const expression& f, const expression *args, integer num_args)
+        : env(env), f(f), args(args), num_args(num_args) { }
+
+    auto operator()(const closure& c) { return c.code->call(env, c, args, num_args); }
+    auto operator()(const native_function& f) { return f(args, num_args); }
+
+    template <typename expression_type>
+    auto operator()(const expression_type& ) { return call_function(env, f, list{std::vector<expression>(args, args + num_args)}); }
+};
+
+}
+
+auto call_function(environment& env, const expression& f, const expression *args, integer num_args) -> expression
+{
+    return apply(call_visitor{env, f, args, num_args}, f);
 }
 
 }
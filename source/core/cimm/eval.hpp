@@ -6,5 +6,7 @@ namespace cimm
 {
 
 auto evaluate_expression(environment& env, const expression& expr) -> expression;
+auto call_function(environment& env, const expression& f, const list& args) -> expression;
+auto call_function(environment& env, const expression& f, const expression *args, integer num_args) -> expression;
 
 }
@@ -1,7 +1,14 @@
 #pragma once
 #include "string.hpp"
 #include "str.hpp"
+#include "intern.hpp"
+#include "ref_count.hpp"
+#include <boost/container/small_vector.hpp>
 #include <boost/variant.hpp>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
 #include <vector>
 
 namespace cimm
@@ -37,8 +44,8 @@ inline auto pr_str(const nil_type& ) -> string
 class symbol
 {
 public:
-    symbol() = default;
-    explicit symbol(string value) : value(value) { }
+    symbol() : symbol(string{}) { }
+    explicit symbol(string value) : value(&intern(value)) { }
 
     friend auto operator==(const symbol& left, const symbol& right)
     {
@@ -47,11 +54,13 @@ public:
 
     friend auto pr_str(const symbol& s) -> string const&
     {
-        return s.value;
+        return *s.value;
     }
 
+    auto std_hash() const { return std::hash<const string *>()(value); }
+
 private:
-    string value;
+    const string *value;
 };
 
 namespace special
@@ -65,14 +74,16 @@ static const symbol catch_{"catch"};
 static const symbol let{"let"};
 static const symbol defgeneric{"defgeneric"};
 static const symbol defmethod{"defmethod"};
+static const symbol loop{"loop"};
+static const symbol recur{"recur"};
 
 }
 
 class keyword
 {
 public:
-    keyword() = default;
-    explicit keyword(string value) : value(std::move(value)) { }
+    keyword() : keyword(string{}) { }
+    explicit keyword(string value) : value(&intern(value)) { }
 
     friend auto operator==(const keyword& left, const keyword& right)
     {
@@ -81,34 +92,68 @@ public:
 
     friend auto pr_str(const keyword& k) -> string
     {
-        return ':' + k.value;
+        return ':' + *k.value;
+    }
+
+    friend auto name(const keyword& k) -> string const&
+    {
+        return *k.value;
     }
 
+    auto std_hash() const { return std::hash<const string *>()(value); }
+
 private:
-    string value;
+    const string *value;
 };
 
 class list;
 class vector;
+class hash_map;
+class hash_set;
 struct function;
+struct closure;
 class expression;
 class error;
 struct environment;
+struct scope;
+class argument_span;
 
 using native_function_va = expression(*)(list const&);
+using native_function_span = expression(*)(argument_span);
+
+class native_callable
+{
+public:
+    virtual ~native_callable() = default;
+    virtual auto operator()(argument_span args) const -> expression = 0;
+};
+
+using native_function_typed = detail::shared_ptr<const native_callable>;
 using native_function_0 = expression(*)();
 using native_function_1 = expression(*)(const expression&);
 using native_function_2 = expression(*)(const expression&, const expression&);
 
+// Built-ins the engines may execute inline while the callee is still the built-in itself
+enum class intrinsic : std::uint8_t
+{
+    none,
+    add,
+    subtract,
+    multiply,
+    less_than
+};
+
 class native_function
 {
 public:
     template <typename func>
-    native_function(const string& name, func f) : name(name), f(f) { }
+    native_function(const string& name, func f, intrinsic op = intrinsic::none) : name(name), f(f), op(op) { }
 
     auto operator()(const list& args) const -> expression;
+    auto operator()(const expression *args, integer num_args) const -> expression;
 
     friend auto name(const native_function& f) { return f.name; }
+    friend auto intrinsic_of(const native_function& f) { return f.op; }
 
     friend auto operator==(const native_function& left, const native_function& right)
     {
@@ -117,7 +162,7 @@ public:
 
 private:
 
-    auto is_va() const { return f.which() == 0; }
+    auto is_va() const { return f.which() == 0 || f.which() >= 4; }
 
     auto has_args(integer n) const { return f.which() == (n + 1); }
 
@@ -127,11 +172,14 @@ private:
         native_function_va,
         native_function_0,
         native_function_1,
-        native_function_2
+        native_function_2,
+        native_function_span,
+        native_function_typed
     >;
 
     string name;
     variant f;
+    intrinsic op;
 };
 
 inline auto pr_str(const native_function& ) -> string
@@ -144,62 +192,228 @@ struct native_function_visitor : boost::static_visitor<result_type> { };
 
 class generic_method;
 
-using expression_variant = boost::variant<
-    nil_type,
-    symbol,
-    keyword,
-    string,
-    integer,
-    boolean,
-    boost::recursive_wrapper<list>,
-    boost::recursive_wrapper<vector>,
-    native_function,
-    boost::recursive_wrapper<function>,
-    boost::recursive_wrapper<error>,
-    boost::recursive_wrapper<generic_method>
->;
+namespace detail
+{
+
+struct box_header
+{
+    mutable reference_count ref_count{1};
+};
+
+template <typename T>
+struct is_hash_cached : std::false_type { };
+
+// Vectors, maps and sets keep their hashes in their root nodes; list cells have no room for one
+template <> struct is_hash_cached<list> : std::true_type { };
+
+template <typename T, bool = is_hash_cached<T>::value>
+struct box_hash { };
+
+// Boxed values never change, so the structural hash is computed once; 0 means not yet computed
+template <typename T>
+struct box_hash<T, true>
+{
+    mutable std::atomic<std::size_t> hash{0};
+};
+
+template <typename T>
+struct box : box_header, box_hash<T>
+{
+    template <typename... Args>
+    explicit box(Args&&... args) : value(std::forward<Args>(args)...) { }
+
+    T value;
+};
+
+template <typename...>
+using void_t = void;
+
+template <typename Visitor, typename = void>
+struct visitor_result
+{
+    using type = decltype(std::declval<Visitor&>()(nil));
+};
+
+template <typename Visitor>
+struct visitor_result<Visitor, void_t<typename Visitor::result_type>>
+{
+    using type = typename Visitor::result_type;
+};
+
+}
 
 class expression
 {
 public:
-    expression() = default;
-    expression(const nil_type& n) : value(n) { }
-    expression(const symbol& s) : value(s) { }
-    expression(const keyword& k) : value(k) { }
-    expression(const string& s) : value(s) { }
-    expression(const integer& i) : value(i) { }
-    expression(const boolean& b) : value(b) { }
-    expression(const list& l) : value(l) { }
-    expression(const vector& v) : value(v) { }
-    expression(native_function f) : value(f) { }
-    expression(const function& f) : value(f) { }
-    expression(const expression_variant& v) : value(v) { }
-    expression(const error& e) : value(e) { }
-    expression(const generic_method& m) : value(m) { }
-
-    template <typename result_type>
-    struct visitor : boost::static_visitor<result_type> { };
+    enum class tag : std::uint8_t
+    {
+        nil,
+        symbol,
+        keyword,
+        string,
+        integer,
+        boolean,
+        list,
+        vector,
+        hash_map,
+        hash_set,
+        native_function,
+        function,
+        closure,
+        error,
+        generic_method
+    };
+
+    expression() noexcept { }
+    expression(const nil_type& ) noexcept { }
+    expression(const symbol& s) noexcept : tag_(tag::symbol) { new (&payload.name) symbol(s); }
+    expression(const keyword& k) noexcept : tag_(tag::keyword) { new (&payload.key) keyword(k); }
+    expression(const integer& i) noexcept : tag_(tag::integer) { payload.i = i; }
+    expression(const boolean& b) noexcept : tag_(tag::boolean) { payload.b = b; }
+    expression(const string& s);
+    expression(const list& l);
+    expression(const vector& v);
+    expression(const hash_map& m);
+    expression(const hash_set& s);
+    expression(native_function f);
+    expression(const function& f);
+    expression(const closure& c);
+    expression(const error& e);
+    expression(const generic_method& m);
+
+    expression(const expression& other) noexcept : tag_(other.tag_), payload(other.payload)
+    {
+        if (is_boxed())
+            payload.boxed->ref_count.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    expression(expression&& other) noexcept : tag_(other.tag_), payload(other.payload)
+    {
+        other.tag_ = tag::nil;
+    }
+
+    auto operator=(const expression& other) noexcept -> expression&
+    {
+        expression copy{other};
+        swap(*this, copy);
+        return *this;
+    }
+
+    auto operator=(expression&& other) noexcept -> expression&
+    {
+        expression moved{std::move(other)};
+        swap(*this, moved);
+        return *this;
+    }
+
+    ~expression()
+    {
+        if (is_boxed() && payload.boxed->ref_count.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            destroy();
+    }
+
+    friend auto swap(expression& left, expression& right) noexcept -> void
+    {
+        std::swap(left.tag_, right.tag_);
+        std::swap(left.payload, right.payload);
+    }
+
+    auto get_tag() const { return tag_; }
+
+    // Structural hash consistent with operator==; cached in boxed lists and in the root nodes of vectors, maps and sets
+    auto std_hash() const -> std::size_t;
+
+    template <typename result>
+    struct visitor
+    {
+        using result_type = result;
+    };
 
     template <typename Visitor>
-    friend auto apply(Visitor&& v, expression const& e)
+    friend auto apply(Visitor&& v, expression const& e) -> typename detail::visitor_result<std::remove_reference_t<Visitor>>::type
     {
-        return boost::apply_visitor(v, e.value);
+        using result = typename detail::visitor_result<std::remove_reference_t<Visitor>>::type;
+        switch (e.tag_)
+        {
+            case tag::nil: return static_cast<result>(v(nil));
+            case tag::symbol: return static_cast<result>(v(e.payload.name));
+            case tag::keyword: return static_cast<result>(v(e.payload.key));
+            case tag::string: return static_cast<result>(v(e.unboxed<string>()));
+            case tag::integer: return static_cast<result>(v(e.payload.i));
+            case tag::boolean: return static_cast<result>(v(e.payload.b));
+            case tag::list: return static_cast<result>(v(e.unboxed<list>()));
+            case tag::vector: return static_cast<result>(v(e.unboxed<vector>()));
+            case tag::hash_map: return static_cast<result>(v(e.unboxed<hash_map>()));
+            case tag::hash_set: return static_cast<result>(v(e.unboxed<hash_set>()));
+            case tag::native_function: return static_cast<result>(v(e.unboxed<native_function>()));
+            case tag::function: return static_cast<result>(v(e.unboxed<function>()));
+            case tag::closure: return static_cast<result>(v(e.unboxed<closure>()));
+            case tag::error: return static_cast<result>(v(e.unboxed<error>()));
+            case tag::generic_method: break;
+        }
+        return static_cast<result>(v(e.unboxed<generic_method>()));
     }
 
     friend auto as_list(const expression& e) -> list const&;
     friend auto as_vector(const expression& e) -> vector const&;
+    friend auto as_hash_map(const expression& e) -> hash_map const&;
+    friend auto as_hash_set(const expression& e) -> hash_set const&;
+    friend auto as_function(const expression& e) -> function const&;
+    friend auto as_closure(const expression& e) -> closure const&;
+    friend auto as_string(const expression& e) -> string const&;
+    friend auto as_boolean(const expression& e) -> boolean;
+    friend auto as_native_function(const expression& e) -> native_function const&;
     friend auto as_symbol(const expression& e) -> symbol const&;
     friend auto as_integer(const expression& e) -> integer;
     friend auto is_error(const expression& e) -> bool;
     friend auto as_generic_method(expression& e) -> generic_method&;
 
 private:
-    expression_variant value;
+    union value
+    {
+        value() : i(0) { }
 
-    friend auto operator==(const expression& left, const expression& right)
+        symbol name;
+        keyword key;
+        integer i;
+        boolean b;
+        detail::box_header *boxed;
+    };
+
+    tag tag_ = tag::nil;
+    value payload;
+
+    template <typename T>
+    expression(tag t, T&& v) : tag_(t)
     {
-        return left.value == right.value;
+        payload.boxed = new detail::box<std::decay_t<T>>(std::forward<T>(v));
+    }
+
+    auto is_boxed() const -> bool
+    {
+        return tag_ != tag::nil && tag_ != tag::symbol && tag_ != tag::keyword && tag_ != tag::integer && tag_ != tag::boolean;
+    }
+
+    template <typename T>
+    auto unboxed() const -> T const&
+    {
+        return static_cast<const detail::box<T> *>(payload.boxed)->value;
     }
+
+    template <typename T>
+    auto unshared() -> T&
+    {
+        if (payload.boxed->ref_count.load(std::memory_order_acquire) != 1)
+            *this = expression{tag_, unboxed<T>()};
+        return static_cast<detail::box<T> *>(payload.boxed)->value;
+    }
+
+    auto destroy() -> void;
+
+    template <typename T>
+    auto cached_hash() const -> std::size_t;
+
+    friend auto operator==(const expression& left, const expression& right) -> bool;
 };
 
 inline auto operator!=(const expression& left, const expression& right)
@@ -212,6 +426,30 @@ inline auto operator==(const function&, const function&)
     return false;
 }
 
+inline auto operator==(const closure&, const closure&)
+{
+    return false;
+}
+
+class argument_span
+{
+public:
+    using iterator = const expression *;
+
+    argument_span(const expression *first, integer size) : first(first), size_(size) { }
+
+    auto begin() const { return first; }
+    auto end() const { return first + size_; }
+    auto size() const { return size_; }
+    auto empty() const { return size_ == 0; }
+    auto operator[](integer index) const -> const expression& { return first[index]; }
+    auto subspan(integer offset) const { return argument_span{first + offset, size_ - offset}; }
+
+private:
+    const expression *first;
+    integer size_;
+};
+
 class error
 {
 public:
@@ -240,6 +478,8 @@ private:
 
 #include "list.hpp"
 #include "vector.hpp"
+#include "hash_map.hpp"
+#include "hash_set.hpp"
 #include "error.hpp"
 
 namespace cimm
@@ -253,6 +493,7 @@ struct function
         list body;
     };
     std::vector<overload> overloads;
+    detail::shared_ptr<const scope> closure;
 };
 
 inline auto pr_str(const function& ) -> string
@@ -260,6 +501,19 @@ inline auto pr_str(const function& ) -> string
     return string{"fn"};
 }
 
+class lambda;
+
+struct closure
+{
+    detail::shared_ptr<const lambda> code;
+    std::vector<expression> captured;
+};
+
+inline auto pr_str(const closure& ) -> string
+{
+    return string{"fn"};
+}
+
 inline auto native_function::verify_accepts_n_args(integer n) const -> void
 {
     if (!is_va() && !has_args(n))
@@ -279,12 +533,50 @@ inline auto native_function::operator()(const list& args) const -> expression
         auto operator()(const native_function_0& f) { return f(); }
         auto operator()(const native_function_1& f) { return f(first(args)); }
         auto operator()(const native_function_2& f) { return f(first(args), first(rest(args))); }
+
+        auto operator()(const native_function_span& f)
+        {
+            boost::container::small_vector<expression, 8> values;
+            for (auto l = args; !is_empty(l); l = rest(l))
+                values.push_back(first(l));
+            return f({values.data(), integer(values.size())});
+        }
+
+        auto operator()(const native_function_typed& f)
+        {
+            boost::container::small_vector<expression, 8> values;
+            for (auto l = args; !is_empty(l); l = rest(l))
+                values.push_back(first(l));
+            return (*f)({values.data(), integer(values.size())});
+        }
     };
 
     evaluate v(args);
     return boost::apply_visitor(v, f);
 }
 
+inline auto native_function::operator()(const expression *args, integer num_args) const -> expression
+{
+    verify_accepts_n_args(num_args);
+
+    struct evaluate : boost::static_visitor<expression>
+    {
+        const expression *args;
+        integer num_args;
+        evaluate(const expression *args, integer num_args) : args(args), num_args(num_args) { }
+
+        auto operator()(const native_function_va& f) { return f(list(args, args + num_args)); }
+        auto operator()(const native_function_0& f) { return f(); }
+        auto operator()(const native_function_1& f) { return f(args[0]); }
+        auto operator()(const native_function_2& f) { return f(args[0], args[1]); }
+        auto operator()(const native_function_span& f) { return f({args, num_args}); }
+        auto operator()(const native_function_typed& f) { return (*f)({args, num_args}); }
+    };
+
+    evaluate v(args, num_args);
+    return boost::apply_visitor(v, f);
+}
+
 class generic_method
 {
 public:
@@ -302,19 +594,214 @@ public:
         return "generic method " + pr_str(m.name);
     }
 
-    friend auto get_concrete_methods(const generic_method& m, const list& ) -> std::vector<function>
+    friend auto get_concrete_methods(const generic_method& m, const list& ) -> std::vector<expression>
     {
         return m.methods;
     }
 
-    friend auto define_method(generic_method& g, function m)
+    friend auto define_method(generic_method& g, expression m)
     {
-        g.methods.push_back(m);
+        g.methods.push_back(std::move(m));
     }
 
 private:
     symbol name;
-    std::vector<function> methods;
+    std::vector<expression> methods;
+};
+
+inline expression::expression(const string& s) : expression(tag::string, s) { }
+inline expression::expression(const list& l) : expression(tag::list, l) { }
+inline expression::expression(const vector& v) : expression(tag::vector, v) { }
+inline expression::expression(const hash_map& m) : expression(tag::hash_map, m) { }
+inline expression::expression(const hash_set& s) : expression(tag::hash_set, s) { }
+inline expression::expression(native_function f) : expression(tag::native_function, std::move(f)) { }
+inline expression::expression(const function& f) : expression(tag::function, f) { }
+inline expression::expression(const closure& c) : expression(tag::closure, c) { }
+inline expression::expression(const error& e) : expression(tag::error, e) { }
+inline expression::expression(const generic_method& m) : expression(tag::generic_method, m) { }
+
+inline auto expression::destroy() -> void
+{
+    switch (tag_)
+    {
+        case tag::string: delete static_cast<detail::box<string> *>(payload.boxed); break;
+        case tag::list: delete static_cast<detail::box<list> *>(payload.boxed); break;
+        case tag::vector: delete static_cast<detail::box<vector> *>(payload.boxed); break;
+        case tag::hash_map: delete static_cast<detail::box<hash_map> *>(payload.boxed); break;
+        case tag::hash_set: delete static_cast<detail::box<hash_set> *>(payload.boxed); break;
+        case tag::native_function: delete static_cast<detail::box<native_function> *>(payload.boxed); break;
+        case tag::function: delete static_cast<detail::box<function> *>(payload.boxed); break;
+        case tag::closure: delete static_cast<detail::box<closure> *>(payload.boxed); break;
+        case tag::error: delete static_cast<detail::box<error> *>(payload.boxed); break;
+        case tag::generic_method: delete static_cast<detail::box<generic_method> *>(payload.boxed); break;
+        default: break;
+    }
+}
+
+inline auto operator==(const expression& left, const expression& right) -> bool
+{
+    if (left.tag_ != right.tag_)
+        return false;
+    switch (left.tag_)
+    {
+        case expression::tag::nil: return true;
+        case expression::tag::symbol: return left.payload.name == right.payload.name;
+        case expression::tag::keyword: return left.payload.key == right.payload.key;
+        case expression::tag::integer: return left.payload.i == right.payload.i;
+        case expression::tag::boolean: return left.payload.b == right.payload.b;
+        case expression::tag::string: return left.unboxed<string>() == right.unboxed<string>();
+        case expression::tag::list: return left.unboxed<list>() == right.unboxed<list>();
+        case expression::tag::vector: return left.unboxed<vector>() == right.unboxed<vector>();
+        case expression::tag::hash_map: return left.unboxed<hash_map>() == right.unboxed<hash_map>();
+        case expression::tag::hash_set: return left.unboxed<hash_set>() == right.unboxed<hash_set>();
+        case expression::tag::native_function: return left.unboxed<native_function>() == right.unboxed<native_function>();
+        case expression::tag::function: return left.unboxed<function>() == right.unboxed<function>();
+        case expression::tag::closure: return left.unboxed<closure>() == right.unboxed<closure>();
+        case expression::tag::error: return left.unboxed<error>() == right.unboxed<error>();
+        case expression::tag::generic_method: break;
+    }
+    return left.unboxed<generic_method>() == right.unboxed<generic_method>();
+}
+
+namespace detail
+{
+
+inline auto hash_combine(std::size_t seed, std::size_t h)
+{
+    return seed ^ (h + 0x9e3779b97f4a7c15ull + (seed << 6) + (seed >> 2));
+}
+
+struct expression_hasher : expression::visitor<std::size_t>
+{
+    auto operator()(const nil_type& ) const -> std::size_t { return 0; }
+    auto operator()(const symbol& s) const { return s.std_hash(); }
+    auto operator()(const keyword& k) const { return hash_combine(k.std_hash(), 1); }
+    auto operator()(const string& s) const { return s.std_hash(); }
+    auto operator()(const integer& i) const { return std::hash<integer>()(i); }
+    auto operator()(const boolean& b) const { return std::hash<boolean>()(b); }
+
+    auto operator()(const list& l) const { return l.std_hash(); }
+    auto operator()(const vector& v) const { return v.std_hash(); }
+    auto operator()(const hash_map& m) const { return m.std_hash(); }
+    auto operator()(const hash_set& s) const { return s.std_hash(); }
+
+    auto operator()(const error& e) const { return hash_combine(6, unwrap(e).std_hash()); }
+    auto operator()(const generic_method& m) const { return hash_combine(7, name(m).std_hash()); }
+
+    // Functions compare by identity at most, so the tag alone keeps hashes consistent with operator==
+    template <typename expression_type>
+    auto operator()(const expression_type& ) const -> std::size_t { return 8; }
+};
+
+}
+
+inline auto list::std_hash() const -> std::size_t
+{
+    std::size_t h = 2;
+    for (auto r = *this; !is_empty(r); r = rest(r))
+        h = detail::hash_combine(h, first(r).std_hash());
+    return h == 0 ? 1 : h;
+}
+
+inline auto vector::std_hash() const -> std::size_t
+{
+    return value.cached_fold(3, [](std::size_t h, const expression& e) { return detail::hash_combine(h, e.std_hash()); });
+}
+
+inline auto hash_map::std_hash() const -> std::size_t
+{
+    return value.cached_hash(4, [](const expression& k, const expression& v) { return detail::hash_combine(k.std_hash(), v.std_hash()); });
+}
+
+inline auto hash_set::std_hash() const -> std::size_t
+{
+    return value.cached_hash(5, [](const expression& e) { return e.std_hash(); });
+}
+
+template <typename T>
+inline auto expression::cached_hash() const -> std::size_t
+{
+    auto& cache = static_cast<const detail::box<T> *>(payload.boxed)->hash;
+    auto h = cache.load(std::memory_order_relaxed);
+    if (h == 0)
+    {
+        h = unboxed<T>().std_hash();
+        cache.store(h, std::memory_order_relaxed);
+    }
+    return h;
+}
+
+inline auto expression::std_hash() const -> std::size_t
+{
+    switch (tag_)
+    {
+        case tag::list: return cached_hash<list>();
+        case tag::vector: return unboxed<vector>().std_hash();
+        case tag::hash_map: return unboxed<hash_map>().std_hash();
+        case tag::hash_set: return unboxed<hash_set>().std_hash();
+        default: return apply(detail::expression_hasher{}, *this);
+    }
+}
+
+}
+
+namespace std
+{
+
+template <>
+struct hash<cimm::symbol>
+{
+    typedef cimm::symbol argument_type;
+    typedef std::size_t result_type;
+    result_type operator()(argument_type const& s) const { return s.std_hash(); }
+};
+
+template <>
+struct hash<cimm::keyword>
+{
+    typedef cimm::keyword argument_type;
+    typedef std::size_t result_type;
+    result_type operator()(argument_type const& k) const { return k.std_hash(); }
+};
+
+template <>
+struct hash<cimm::expression>
+{
+    typedef cimm::expression argument_type;
+    typedef std::size_t result_type;
+    result_type operator()(argument_type const& e) const { return e.std_hash(); }
+};
+
+template <>
+struct hash<cimm::list>
+{
+    typedef cimm::list argument_type;
+    typedef std::size_t result_type;
+    result_type operator()(argument_type const& l) const { return l.std_hash(); }
+};
+
+template <>
+struct hash<cimm::vector>
+{
+    typedef cimm::vector argument_type;
+    typedef std::size_t result_type;
+    result_type operator()(argument_type const& v) const { return v.std_hash(); }
+};
+
+template <>
+struct hash<cimm::hash_map>
+{
+    typedef cimm::hash_map argument_type;
+    typedef std::size_t result_type;
+    result_type operator()(argument_type const& m) const { return m.std_hash(); }
+};
+
+template <>
+struct hash<cimm::hash_set>
+{
+    typedef cimm::hash_set argument_type;
+    typedef std::size_t result_type;
+    result_type operator()(argument_type const& s) const { return s.std_hash(); }
 };
 
 }
@@ -0,0 +1,103 @@
+#pragma once
+#include "expression.hpp"
+#include "persistent_hash_map.hpp"
+#include "vector.hpp"
+
+namespace cimm
+{
+
+namespace detail
+{
+
+struct expression_hash
+{
+    auto operator()(const expression& e) const { return e.std_hash(); }
+};
+
+}
+
+class hash_map
+{
+public:
+    hash_map() = default;
+
+    hash_map(const std::initializer_list<std::pair<expression, expression>>& l)
+    {
+        for (auto& e : l)
+            value = value.assoc(e.first, e.second);
+    }
+
+    // Structural hash, kept in the root node
+    auto std_hash() const -> std::size_t;
+
+    friend auto count(const hash_map& m) -> integer
+    {
+        return m.value.size();
+    }
+
+    friend auto is_empty(const hash_map& m)
+    {
+        return m.value.empty();
+    }
+
+    friend auto get(const hash_map& m, const expression& key) -> const expression *
+    {
+        return m.value.find(key);
+    }
+
+    friend auto contains(const hash_map& m, const expression& key)
+    {
+        return m.value.contains(key);
+    }
+
+    friend auto assoc(const hash_map& m, const expression& key, const expression& val)
+    {
+        return hash_map(m.value.assoc(key, val));
+    }
+
+    friend auto dissoc(const hash_map& m, const expression& key)
+    {
+        return hash_map(m.value.dissoc(key));
+    }
+
+    template <typename F>
+    friend auto for_each(const hash_map& m, F&& f)
+    {
+        m.value.for_each(f);
+    }
+
+    // A map literal keeps its key and value forms in source order, including keys replaced by later equal ones
+    friend auto with_source_forms(const hash_map& m, vector forms)
+    {
+        auto literal = m;
+        literal.forms = std::move(forms);
+        return literal;
+    }
+
+    // The key and value forms to evaluate: those of a literal in source order, otherwise the entries in any order
+    friend auto source_forms(const hash_map& m) -> vector
+    {
+        if (!is_empty(m.forms) || is_empty(m))
+            return m.forms;
+        transient_vector<expression> forms;
+        m.value.for_each([&](auto& k, auto& v)
+        {
+            forms.push_back(k);
+            forms.push_back(v);
+        });
+        return std::move(forms).persistent();
+    }
+
+    friend auto operator==(const hash_map& left, const hash_map& right)
+    {
+        return left.value == right.value;
+    }
+
+private:
+    persistent_hash_map<expression, expression, detail::expression_hash> value;
+    vector forms;
+
+    hash_map(persistent_hash_map<expression, expression, detail::expression_hash> value) : value(std::move(value)) { }
+};
+
+}
@@ -0,0 +1,81 @@
+#pragma once
+#include "expression.hpp"
+#include "hash_map.hpp"
+#include "persistent_hash_set.hpp"
+#include "vector.hpp"
+
+namespace cimm
+{
+
+class hash_set
+{
+public:
+    hash_set() = default;
+
+    hash_set(const std::initializer_list<expression>& l) : value(l) { }
+
+    // Structural hash, kept in the root node
+    auto std_hash() const -> std::size_t;
+
+    friend auto count(const hash_set& s) -> integer
+    {
+        return s.value.size();
+    }
+
+    friend auto is_empty(const hash_set& s)
+    {
+        return s.value.empty();
+    }
+
+    friend auto contains(const hash_set& s, const expression& key)
+    {
+        return s.value.contains(key);
+    }
+
+    friend auto conj(const hash_set& s, expression e)
+    {
+        return hash_set(s.value.insert(e));
+    }
+
+    friend auto disj(const hash_set& s, const expression& key)
+    {
+        return hash_set(s.value.erase(key));
+    }
+
+    template <typename F>
+    friend auto for_each(const hash_set& s, F&& f)
+    {
+        s.value.for_each(f);
+    }
+
+    // A set literal keeps its element forms in source order, including ones equal to earlier elements
+    friend auto with_source_forms(const hash_set& s, vector forms)
+    {
+        auto literal = s;
+        literal.forms = std::move(forms);
+        return literal;
+    }
+
+    // The element forms to evaluate: those of a literal in source order, otherwise the elements in any order
+    friend auto source_forms(const hash_set& s) -> vector
+    {
+        if (!is_empty(s.forms) || is_empty(s))
+            return s.forms;
+        transient_vector<expression> forms;
+        s.value.for_each([&](auto& e) { forms.push_back(e); });
+        return std::move(forms).persistent();
+    }
+
+    friend auto operator==(const hash_set& left, const hash_set& right)
+    {
+        return left.value == right.value;
+    }
+
+private:
+    persistent_hash_set<expression, detail::expression_hash> value;
+    vector forms;
+
+    hash_set(persistent_hash_set<expression, detail::expression_hash> value) : value(std::move(value)) { }
+};
+
+}
@@ -0,0 +1,16 @@
+#include "intern.hpp"
+#include <mutex>
+#include <unordered_set>
+
+namespace cimm
+{
+
+auto intern(const string& s) -> const string&
+{
+    static std::mutex table_mutex;
+    static std::unordered_set<string> table;
+    std::lock_guard<std::mutex> lock(table_mutex);
+    return *table.insert(s).first;
+}
+
+}
@@ -0,0 +1,9 @@
+#pragma once
+#include "string.hpp"
+
+namespace cimm
+{
+
+auto intern(const string& s) -> const string&;
+
+}
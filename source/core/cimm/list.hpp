@@ -23,6 +23,15 @@ public:
             value = slist{e, value};
     }
 
+    list(const expression *first, const expression *last)
+    {
+        while (last != first)
+            value = slist{*--last, value};
+    }
+
+    // Structural hash, never 0; not cached, boxed lists keep it in the box
+    auto std_hash() const -> std::size_t;
+
 private:
     slist value;
 
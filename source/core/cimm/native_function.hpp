@@ -0,0 +1,142 @@
+#pragma once
+#include "expression.hpp"
+#include "error.hpp"
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+namespace cimm
+{
+
+auto as_list(const expression& e) -> list const&;
+auto as_vector(const expression& e) -> vector const&;
+auto as_hash_map(const expression& e) -> hash_map const&;
+auto as_hash_set(const expression& e) -> hash_set const&;
+auto as_string(const expression& e) -> string const&;
+auto as_symbol(const expression& e) -> symbol const&;
+auto as_integer(const expression& e) -> integer;
+auto as_boolean(const expression& e) -> boolean;
+
+namespace detail
+{
+
+// Parameter types make_native_function accepts, each by value or const reference:
+// expression, integer, boolean, string, symbol, list, vector, hash_map and hash_set.
+// Add a specialization here to accept another one.
+template <typename T>
+struct native_arg;
+
+template <>
+struct native_arg<expression>
+{
+    static auto get(const expression& e) -> const expression& { return e; }
+};
+
+template <>
+struct native_arg<integer>
+{
+    static auto get(const expression& e) { return as_integer(e); }
+};
+
+template <>
+struct native_arg<boolean>
+{
+    static auto get(const expression& e) { return as_boolean(e); }
+};
+
+template <>
+struct native_arg<string>
+{
+    static auto get(const expression& e) -> const string& { return as_string(e); }
+};
+
+template <>
+struct native_arg<symbol>
+{
+    static auto get(const expression& e) -> const symbol& { return as_symbol(e); }
+};
+
+template <>
+struct native_arg<list>
+{
+    static auto get(const expression& e) -> const list& { return as_list(e); }
+};
+
+template <>
+struct native_arg<vector>
+{
+    static auto get(const expression& e) -> const vector& { return as_vector(e); }
+};
+
+template <>
+struct native_arg<hash_map>
+{
+    static auto get(const expression& e) -> const hash_map& { return as_hash_map(e); }
+};
+
+template <>
+struct native_arg<hash_set>
+{
+    static auto get(const expression& e) -> const hash_set& { return as_hash_set(e); }
+};
+
+template <typename F>
+struct native_signature : native_signature<decltype(&F::operator())> { };
+
+template <typename R, typename... Args>
+struct native_signature<R(*)(Args...)>
+{
+    using result = R;
+    using args = std::tuple<Args...>;
+};
+
+template <typename C, typename R, typename... Args>
+struct native_signature<R(C::*)(Args...)> : native_signature<R(*)(Args...)> { };
+
+template <typename C, typename R, typename... Args>
+struct native_signature<R(C::*)(Args...) const> : native_signature<R(*)(Args...)> { };
+
+template <typename F, typename R, typename Args, typename Indices>
+class typed_native;
+
+template <typename F, typename R, typename... Args, std::size_t... I>
+class typed_native<F, R, std::tuple<Args...>, std::index_sequence<I...>> : public native_callable
+{
+public:
+    typed_native(const string& name, F f) : name(name), f(std::move(f)) { }
+
+    auto operator()(argument_span args) const -> expression override
+    {
+        if (args.size() != integer(sizeof...(Args)))
+            throw arity_error(args.size(), name);
+        return call(std::is_void<R>{}, args);
+    }
+
+private:
+    string name;
+    F f;
+
+    auto call(std::false_type, argument_span args) const -> expression
+    {
+        return f(native_arg<std::decay_t<Args>>::get(args[I])...);
+    }
+
+    auto call(std::true_type, argument_span args) const -> expression
+    {
+        f(native_arg<std::decay_t<Args>>::get(args[I])...);
+        return nil;
+    }
+};
+
+}
+
+template <typename F>
+auto make_native_function(const string& name, F f) -> native_function
+{
+    using signature = detail::native_signature<std::decay_t<F>>;
+    using args = typename signature::args;
+    using native = detail::typed_native<std::decay_t<F>, typename signature::result, args, std::make_index_sequence<std::tuple_size<args>::value>>;
+    return {name, native_function_typed{detail::make_shared<native>(name, std::move(f))}};
+}
+
+}
@@ -1,4 +1,5 @@
 #include "parse.hpp"
+#include "str.hpp"
 #include <boost/spirit/home/qi.hpp>
 #include <boost/spirit/include/phoenix.hpp>
 #include <boost/spirit/include/qi_expect.hpp>
@@ -19,6 +20,29 @@ auto quote_expr(const expression& e) -> list
     return list{special::quote, e};
 }
 
+auto make_vector(std::vector<expression>& elems) -> vector
+{
+    return vector(std::move(elems));
+}
+
+auto make_hash_set(std::vector<expression>& elems) -> hash_set
+{
+    hash_set s;
+    for (auto& e : elems)
+        s = conj(s, e);
+    return with_source_forms(s, vector(std::move(elems)));
+}
+
+auto make_hash_map(std::vector<expression>& elems) -> hash_map
+{
+    if (elems.size() % 2 != 0)
+        throw parse_error("map literal must contain an even number of forms");
+    hash_map m;
+    for (std::size_t i = 0; i < elems.size(); i += 2)
+        m = assoc(m, elems[i], elems[i + 1]);
+    return with_source_forms(m, vector(std::move(elems)));
+}
+
 template <typename iterator>
 struct expression_grammar : boost::spirit::qi::grammar<iterator, std::vector<expression>(), ascii::space_type>
 {
@@ -26,29 +50,37 @@ struct expression_grammar : boost::spirit::qi::grammar<iterator, std::vector<exp
     {
         escaped.add("\\n", '\n')("\\\\", '\\')("\\\"", '\"');
         quote_rule = qi::lit('\'') > expression_rule[_val = bind(quote_expr, _1)];
-        expression_variant_rule = qi::int_ | boolean_rule | list_rule | vector_rule | string_rule | keyword_rule | nil_rule | symbol_rule;
+        vector_rule = vector_vector_rule[_val = bind(make_vector, _1)];
+        hash_map_rule = hash_map_vector_rule[_val = bind(make_hash_map, _1)];
+        hash_set_rule = hash_set_vector_rule[_val = bind(make_hash_set, _1)];
+        value_rule = qi::int_ | boolean_rule | list_rule | vector_rule | hash_map_rule | hash_set_rule | string_rule | keyword_rule | nil_rule | symbol_rule;
     }
 
     template <typename type>
     using rule = qi::rule<iterator, type(), ascii::space_type>;
 
     qi::symbols<char const, char const> escaped;
-    rule<std::string> string_rule{qi::lit('\"') >> qi::no_skip[*(escaped | (qi::char_ - '\"'))] > qi::lit('\"')};
-    decltype(qi::char_ - ')' - ']' - ' ' - '\n' - '\"') symbol_char{qi::char_ - ')' - ']' - ' ' - '\n' - '\"'};
+    rule<std::string> string_char_seq_rule{qi::lit('\"') >> qi::no_skip[*(escaped | (qi::char_ - '\"'))] > qi::lit('\"')};
+    rule<string> string_rule{string_char_seq_rule};
+    decltype(qi::char_ - ')' - ']' - '}' - ' ' - '\n' - '\"') symbol_char{qi::char_ - ')' - ']' - '}' - ' ' - '\n' - '\"'};
     rule<std::string> char_seq_rule{qi::no_skip[+symbol_char]};
     rule<string> keyword_char_seq_rule{qi::lit(':') >> char_seq_rule};
     rule<keyword> keyword_rule{keyword_char_seq_rule};
     rule<symbol> symbol_rule{char_seq_rule};
-    rule<expression_variant> expression_variant_rule;
+    rule<expression> value_rule;
     rule<list> quote_rule;
-    rule<expression> expression_rule{qi::as<expression>()[quote_rule | expression_variant_rule]};
+    rule<expression> expression_rule{qi::as<expression>()[quote_rule | value_rule]};
     rule<std::vector<expression>> expressions_rule = *expression_rule;
     rule<std::vector<expression>> list_vector_rule{qi::lit('(') >> *expression_rule > qi::lit(')')};
     rule<std::vector<expression>> vector_vector_rule{qi::lit('[') >> *expression_rule > qi::lit(']')};
+    rule<std::vector<expression>> hash_map_vector_rule{qi::lit('{') >> *expression_rule > qi::lit('}')};
+    rule<std::vector<expression>> hash_set_vector_rule{qi::lit("#{") >> *expression_rule > qi::lit('}')};
     rule<boolean> boolean_rule{(qi::no_skip[qi::lit("true") >> !symbol_char] >> qi::attr(true)) | (qi::no_skip[qi::lit("false") >> !symbol_char] >> qi::attr(false))};
     rule<nil_type> nil_rule{qi::no_skip[qi::lit("nil") >> !symbol_char] >> qi::attr(nil)};
     rule<list> list_rule{list_vector_rule};
-    rule<vector> vector_rule{vector_vector_rule};
+    rule<vector> vector_rule;
+    rule<hash_map> hash_map_rule;
+    rule<hash_set> hash_set_rule;
 };
 
 }
@@ -76,7 +108,7 @@ auto parse_expressions(const string& expr_text) -> vector
     if (first != end(expr_text))
         throw parse_error(string{"unexpected "} + *first);
 
-    return vector{exprs};
+    return vector(std::move(exprs));
 }
 
 }
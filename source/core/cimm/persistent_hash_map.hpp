@@ -0,0 +1,564 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <new>
+#include <utility>
+#include "pool.hpp"
+#include "ref_count.hpp"
+
+namespace cimm
+{
+
+namespace detail
+{
+
+// Hash array mapped trie with separate entry and child bitmaps (CHAMP layout); KeyOf extracts the key of an entry
+template <typename K, typename Entry, typename KeyOf, typename Hash, typename KeyEqual>
+class hash_trie
+{
+public:
+    using size_type = std::size_t;
+
+    hash_trie() = default;
+
+    size_type size() const { return count; }
+    bool empty() const { return count == 0; }
+
+    const Entry *find(const K& key) const
+    {
+        auto h = Hash{}(key);
+        auto n = root ? &*root : nullptr;
+        for (unsigned shift = 0; n; shift += bits_per_level)
+        {
+            if (shift >= hash_bits)
+                return find_colliding(*n, key);
+            auto bit = bit_for(h, shift);
+            if (n->datamap & bit)
+            {
+                auto& e = n->entries()[index_of(n->datamap, bit)];
+                return KeyEqual{}(KeyOf{}(e), key) ? &e : nullptr;
+            }
+            if (!(n->nodemap & bit))
+                return nullptr;
+            n = &*n->children()[index_of(n->nodemap, bit)];
+        }
+        return nullptr;
+    }
+
+    // Adds the entry or replaces the one with an equal key
+    hash_trie insert(const Entry& entry) const
+    {
+        auto h = Hash{}(KeyOf{}(entry));
+        bool added = !root;
+        auto new_root = root ? insert(*root, 0, h, entry, added) : make_entry_node(entry, h, 0);
+        return hash_trie{std::move(new_root), count + (added ? 1 : 0)};
+    }
+
+    hash_trie erase(const K& key) const
+    {
+        if (!root)
+            return *this;
+        bool removed = false;
+        auto new_root = erase(root, 0, Hash{}(key), key, removed);
+        if (!removed)
+            return *this;
+        return hash_trie{std::move(new_root), count - 1};
+    }
+
+    template <typename F>
+    void for_each(F&& f) const
+    {
+        if (root)
+            for_each(*root, f);
+    }
+
+    bool shares_root_with(const hash_trie& other) const { return root.get() == other.root.get(); }
+
+    // seed plus the sum of entry_hash over all entries; the sum is kept in the root node, so entry_hash must not vary
+    template <typename F>
+    std::size_t cached_sum(std::size_t seed, F entry_hash) const
+    {
+        if (!root)
+            return seed;
+        auto& r = *root;
+        if (!r.summed.load(std::memory_order_acquire))
+        {
+            std::size_t sum = 0;
+            auto add = [&](const Entry& e) { sum += entry_hash(e); };
+            for_each(r, add);
+            r.sum.store(sum, std::memory_order_relaxed);
+            r.summed.store(true, std::memory_order_release);
+        }
+        return seed + r.sum.load(std::memory_order_relaxed);
+    }
+
+private:
+
+    static const unsigned bits_per_level = 5;
+    static const unsigned hash_bits = sizeof(std::size_t) * 8;
+
+    struct node;
+
+    class ptr
+    {
+    public:
+        ptr() = default;
+        explicit ptr(node *p) : p(p) { }
+        ptr(const ptr& other) : p(other.p) { if (p) p->ref_count.fetch_add(1, std::memory_order_relaxed); }
+        ptr(ptr&& other) noexcept : p(other.p) { other.p = nullptr; }
+
+        ptr& operator=(ptr other) noexcept
+        {
+            std::swap(p, other.p);
+            return *this;
+        }
+
+        ~ptr()
+        {
+            if (p && p->ref_count.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                destroy(p, node_size(p->num_entries, p->num_children));
+        }
+
+        explicit operator bool() const { return p; }
+        node& operator*() const { return *p; }
+        node *operator->() const { return p; }
+        node *get() const { return p; }
+
+    private:
+        node *p = nullptr;
+    };
+
+    // Entries and then children are stored inline after the header, in one pooled block sized by their counts.
+    // A node below the last hash level holds colliding entries only
+    struct node
+    {
+        mutable reference_count ref_count{1};
+        std::uint32_t datamap;
+        std::uint32_t nodemap;
+        std::uint32_t num_entries = 0;
+        std::uint32_t num_children = 0;
+        std::uint32_t children_offset;
+        mutable std::atomic<bool> summed{false};
+        mutable std::atomic<std::size_t> sum{0};
+
+        node(std::uint32_t datamap, std::uint32_t nodemap, std::uint32_t children_offset)
+            : datamap(datamap), nodemap(nodemap), children_offset(children_offset) { }
+
+        Entry *entries() { return reinterpret_cast<Entry *>(reinterpret_cast<unsigned char *>(this) + entries_offset()); }
+        const Entry *entries() const { return const_cast<node *>(this)->entries(); }
+        ptr *children() { return reinterpret_cast<ptr *>(reinterpret_cast<unsigned char *>(this) + children_offset); }
+        const ptr *children() const { return const_cast<node *>(this)->children(); }
+    };
+
+    static constexpr size_type align_up(size_type size, size_type alignment)
+    {
+        return (size + alignment - 1) / alignment * alignment;
+    }
+
+    static constexpr size_type entries_offset() { return align_up(sizeof(node), alignof(Entry)); }
+
+    static constexpr size_type children_offset(size_type num_entries)
+    {
+        return align_up(entries_offset() + num_entries * sizeof(Entry), alignof(ptr));
+    }
+
+    static constexpr size_type node_size(size_type num_entries, size_type num_children)
+    {
+        return children_offset(num_entries) + num_children * sizeof(ptr);
+    }
+
+    static void destroy(node *n, size_type size) noexcept
+    {
+        for (auto e = n->entries(), last = e + n->num_entries; e != last; ++e)
+            e->~Entry();
+        for (auto c = n->children(), last = c + n->num_children; c != last; ++c)
+            c->~ptr();
+        n->~node();
+        deallocate_bytes(n, size);
+    }
+
+    // Fills a new node with exactly the announced number of entries, followed by the children
+    class node_builder
+    {
+    public:
+        node_builder(std::uint32_t datamap, std::uint32_t nodemap, size_type num_entries, size_type num_children)
+            : size(node_size(num_entries, num_children))
+        {
+            static_assert(alignof(Entry) <= alignof(std::max_align_t), "pooled blocks must be able to hold entries");
+            n = new (allocate_bytes(size)) node{datamap, nodemap, std::uint32_t(children_offset(num_entries))};
+        }
+
+        node_builder(const node_builder& ) = delete;
+        node_builder& operator=(const node_builder& ) = delete;
+
+        ~node_builder()
+        {
+            if (n)
+                destroy(n, size);
+        }
+
+        void add_entry(const Entry& e)
+        {
+            new (n->entries() + n->num_entries) Entry(e);
+            ++n->num_entries;
+        }
+
+        void add_entries(const Entry *first, const Entry *last)
+        {
+            for (; first != last; ++first)
+                add_entry(*first);
+        }
+
+        void add_child(ptr c)
+        {
+            new (n->children() + n->num_children) ptr(std::move(c));
+            ++n->num_children;
+        }
+
+        void add_children(const ptr *first, const ptr *last)
+        {
+            for (; first != last; ++first)
+                add_child(*first);
+        }
+
+        ptr finish()
+        {
+            auto p = n;
+            n = nullptr;
+            return ptr{p};
+        }
+
+    private:
+        node *n;
+        size_type size;
+    };
+
+    ptr root;
+    size_type count = 0;
+
+    hash_trie(ptr root, size_type count) : root(std::move(root)), count(count) { }
+
+    static const K& key_of(const Entry& e) { return KeyOf{}(e); }
+
+    static std::uint32_t bit_for(std::size_t hash, unsigned shift)
+    {
+        return std::uint32_t(1) << ((hash >> shift) & ((1u << bits_per_level) - 1));
+    }
+
+    static unsigned popcount(std::uint32_t bits)
+    {
+#if defined(__GNUC__)
+        return __builtin_popcount(bits);
+#else
+        bits = bits - ((bits >> 1) & 0x55555555u);
+        bits = (bits & 0x33333333u) + ((bits >> 2) & 0x33333333u);
+        return (((bits + (bits >> 4)) & 0x0f0f0f0fu) * 0x01010101u) >> 24;
+#endif
+    }
+
+    static size_type index_of(std::uint32_t bitmap, std::uint32_t bit)
+    {
+        return popcount(bitmap & (bit - 1));
+    }
+
+    static const Entry *find_colliding(const node& n, const K& key)
+    {
+        for (auto e = n.entries(), last = e + n.num_entries; e != last; ++e)
+            if (KeyEqual{}(key_of(*e), key))
+                return e;
+        return nullptr;
+    }
+
+    static ptr make_entry_node(const Entry& entry, std::size_t hash, unsigned shift)
+    {
+        node_builder b{shift < hash_bits ? bit_for(hash, shift) : 0, 0, 1, 0};
+        b.add_entry(entry);
+        return b.finish();
+    }
+
+    static ptr merge(const Entry& e1, std::size_t h1, const Entry& e2, std::size_t h2, unsigned shift)
+    {
+        if (shift >= hash_bits)
+        {
+            node_builder b{0, 0, 2, 0};
+            b.add_entry(e1);
+            b.add_entry(e2);
+            return b.finish();
+        }
+        auto b1 = bit_for(h1, shift);
+        auto b2 = bit_for(h2, shift);
+        if (b1 == b2)
+        {
+            node_builder b{0, b1, 0, 1};
+            b.add_child(merge(e1, h1, e2, h2, shift + bits_per_level));
+            return b.finish();
+        }
+        node_builder b{b1 | b2, 0, 2, 0};
+        b.add_entry(b1 < b2 ? e1 : e2);
+        b.add_entry(b1 < b2 ? e2 : e1);
+        return b.finish();
+    }
+
+    static ptr replace_entry(const node& n, size_type i, const Entry& entry)
+    {
+        auto e = n.entries();
+        node_builder b{n.datamap, n.nodemap, n.num_entries, n.num_children};
+        b.add_entries(e, e + i);
+        b.add_entry(entry);
+        b.add_entries(e + i + 1, e + n.num_entries);
+        b.add_children(n.children(), n.children() + n.num_children);
+        return b.finish();
+    }
+
+    // bit is 0 for colliding entries
+    static ptr insert_entry(const node& n, std::uint32_t bit, size_type i, const Entry& entry)
+    {
+        auto e = n.entries();
+        node_builder b{n.datamap | bit, n.nodemap, n.num_entries + 1, n.num_children};
+        b.add_entries(e, e + i);
+        b.add_entry(entry);
+        b.add_entries(e + i, e + n.num_entries);
+        b.add_children(n.children(), n.children() + n.num_children);
+        return b.finish();
+    }
+
+    static ptr remove_entry(const node& n, std::uint32_t bit, size_type i)
+    {
+        auto e = n.entries();
+        node_builder b{n.datamap & ~bit, n.nodemap, n.num_entries - 1, n.num_children};
+        b.add_entries(e, e + i);
+        b.add_entries(e + i + 1, e + n.num_entries);
+        b.add_children(n.children(), n.children() + n.num_children);
+        return b.finish();
+    }
+
+    static ptr replace_child(const node& n, size_type ci, ptr child)
+    {
+        auto c = n.children();
+        node_builder b{n.datamap, n.nodemap, n.num_entries, n.num_children};
+        b.add_entries(n.entries(), n.entries() + n.num_entries);
+        b.add_children(c, c + ci);
+        b.add_child(std::move(child));
+        b.add_children(c + ci + 1, c + n.num_children);
+        return b.finish();
+    }
+
+    static ptr remove_child(const node& n, std::uint32_t bit, size_type ci)
+    {
+        auto c = n.children();
+        node_builder b{n.datamap, n.nodemap & ~bit, n.num_entries, n.num_children - 1};
+        b.add_entries(n.entries(), n.entries() + n.num_entries);
+        b.add_children(c, c + ci);
+        b.add_children(c + ci + 1, c + n.num_children);
+        return b.finish();
+    }
+
+    // Replaces the entry at bit with a child holding it and another entry
+    static ptr entry_to_child(const node& n, std::uint32_t bit, size_type i, ptr child)
+    {
+        auto e = n.entries();
+        auto c = n.children();
+        auto nodemap = n.nodemap | bit;
+        auto ci = index_of(nodemap, bit);
+        node_builder b{n.datamap & ~bit, nodemap, n.num_entries - 1, n.num_children + 1};
+        b.add_entries(e, e + i);
+        b.add_entries(e + i + 1, e + n.num_entries);
+        b.add_children(c, c + ci);
+        b.add_child(std::move(child));
+        b.add_children(c + ci, c + n.num_children);
+        return b.finish();
+    }
+
+    // Replaces the child at bit with its only entry
+    static ptr child_to_entry(const node& n, std::uint32_t bit, size_type ci, const Entry& entry)
+    {
+        auto e = n.entries();
+        auto c = n.children();
+        auto i = index_of(n.datamap, bit);
+        node_builder b{n.datamap | bit, n.nodemap & ~bit, n.num_entries + 1, n.num_children - 1};
+        b.add_entries(e, e + i);
+        b.add_entry(entry);
+        b.add_entries(e + i, e + n.num_entries);
+        b.add_children(c, c + ci);
+        b.add_children(c + ci + 1, c + n.num_children);
+        return b.finish();
+    }
+
+    static ptr insert(const node& n, unsigned shift, std::size_t h, const Entry& entry, bool& added)
+    {
+        auto& key = key_of(entry);
+        if (shift >= hash_bits)
+        {
+            for (size_type i = 0; i < n.num_entries; ++i)
+                if (KeyEqual{}(key_of(n.entries()[i]), key))
+                    return replace_entry(n, i, entry);
+            added = true;
+            return insert_entry(n, 0, n.num_entries, entry);
+        }
+        auto bit = bit_for(h, shift);
+        if (n.datamap & bit)
+        {
+            auto i = index_of(n.datamap, bit);
+            auto& e = n.entries()[i];
+            if (KeyEqual{}(key_of(e), key))
+                return replace_entry(n, i, entry);
+            added = true;
+            return entry_to_child(n, bit, i, merge(e, Hash{}(key_of(e)), entry, h, shift + bits_per_level));
+        }
+        if (n.nodemap & bit)
+        {
+            auto ci = index_of(n.nodemap, bit);
+            return replace_child(n, ci, insert(*n.children()[ci], shift + bits_per_level, h, entry, added));
+        }
+        added = true;
+        return insert_entry(n, bit, index_of(n.datamap, bit), entry);
+    }
+
+    static bool is_single_entry(const node& n)
+    {
+        return n.num_entries == 1 && n.num_children == 0;
+    }
+
+    static ptr erase(const ptr& n, unsigned shift, std::size_t h, const K& key, bool& removed)
+    {
+        if (shift >= hash_bits)
+        {
+            for (size_type i = 0; i < n->num_entries; ++i)
+                if (KeyEqual{}(key_of(n->entries()[i]), key))
+                {
+                    removed = true;
+                    if (n->num_entries == 1)
+                        return ptr{};
+                    return remove_entry(*n, 0, i);
+                }
+            return n;
+        }
+        auto bit = bit_for(h, shift);
+        if (n->datamap & bit)
+        {
+            auto i = index_of(n->datamap, bit);
+            if (!KeyEqual{}(key_of(n->entries()[i]), key))
+                return n;
+            removed = true;
+            if (is_single_entry(*n))
+                return ptr{};
+            return remove_entry(*n, bit, i);
+        }
+        if (!(n->nodemap & bit))
+            return n;
+        auto ci = index_of(n->nodemap, bit);
+        auto child = erase(n->children()[ci], shift + bits_per_level, h, key, removed);
+        if (!removed)
+            return n;
+        if (!child && n->num_entries == 0 && n->num_children == 1)
+            return ptr{};
+        if (!child)
+            return remove_child(*n, bit, ci);
+        if (is_single_entry(*child))
+            return child_to_entry(*n, bit, ci, child->entries()[0]);
+        return replace_child(*n, ci, std::move(child));
+    }
+
+    template <typename F>
+    static void for_each(const node& n, F& f)
+    {
+        for (auto e = n.entries(), last = e + n.num_entries; e != last; ++e)
+            f(*e);
+        for (auto c = n.children(), last = c + n.num_children; c != last; ++c)
+            for_each(**c, f);
+    }
+};
+
+struct first_of_pair
+{
+    template <typename Pair>
+    auto operator()(const Pair& p) const -> const typename Pair::first_type& { return p.first; }
+};
+
+}
+
+template <typename K, typename V, typename Hash = std::hash<K>, typename KeyEqual = std::equal_to<K>>
+class persistent_hash_map
+{
+public:
+    using key_type = K;
+    using mapped_type = V;
+    using value_type = std::pair<K, V>;
+    using size_type = std::size_t;
+
+    persistent_hash_map() = default;
+
+    persistent_hash_map(std::initializer_list<value_type> l)
+    {
+        for (auto& e : l)
+            trie = trie.insert(e);
+    }
+
+    size_type size() const { return trie.size(); }
+    bool empty() const { return trie.empty(); }
+
+    const V *find(const K& key) const
+    {
+        auto e = trie.find(key);
+        return e ? &e->second : nullptr;
+    }
+
+    bool contains(const K& key) const { return trie.find(key) != nullptr; }
+
+    persistent_hash_map assoc(const K& key, const V& value) const
+    {
+        return persistent_hash_map(trie.insert(value_type{key, value}));
+    }
+
+    persistent_hash_map dissoc(const K& key) const
+    {
+        return persistent_hash_map(trie.erase(key));
+    }
+
+    template <typename F>
+    void for_each(F&& f) const
+    {
+        trie.for_each([&](const value_type& e) { f(e.first, e.second); });
+    }
+
+    // seed plus the sum of entry_hash(key, value) over all entries, kept in the root node; entry_hash must not vary
+    template <typename F>
+    size_type cached_hash(size_type seed, F entry_hash) const
+    {
+        return trie.cached_sum(seed, [&](const value_type& e) { return entry_hash(e.first, e.second); });
+    }
+
+    friend bool operator==(const persistent_hash_map& left, const persistent_hash_map& right)
+    {
+        if (left.size() != right.size())
+            return false;
+        if (left.trie.shares_root_with(right.trie))
+            return true;
+        bool equal = true;
+        left.for_each([&](const K& k, const V& v)
+        {
+            if (!equal)
+                return;
+            auto found = right.find(k);
+            equal = found && *found == v;
+        });
+        return equal;
+    }
+
+    friend bool operator!=(const persistent_hash_map& left, const persistent_hash_map& right)
+    {
+        return !(left == right);
+    }
+
+private:
+    using trie_type = detail::hash_trie<K, value_type, detail::first_of_pair, Hash, KeyEqual>;
+
+    trie_type trie;
+
+    explicit persistent_hash_map(trie_type trie) : trie(std::move(trie)) { }
+};
+
+}
@@ -0,0 +1,86 @@
+#pragma once
+#include "persistent_hash_map.hpp"
+
+namespace cimm
+{
+
+namespace detail
+{
+
+struct identity_key
+{
+    template <typename K>
+    auto operator()(const K& k) const -> const K& { return k; }
+};
+
+}
+
+template <typename K, typename Hash = std::hash<K>, typename KeyEqual = std::equal_to<K>>
+class persistent_hash_set
+{
+public:
+    using key_type = K;
+    using value_type = K;
+    using size_type = std::size_t;
+
+    persistent_hash_set() = default;
+
+    persistent_hash_set(std::initializer_list<K> l)
+    {
+        for (auto& k : l)
+            *this = insert(k);
+    }
+
+    size_type size() const { return trie.size(); }
+    bool empty() const { return trie.empty(); }
+
+    bool contains(const K& key) const { return trie.find(key) != nullptr; }
+
+    persistent_hash_set insert(const K& key) const
+    {
+        return contains(key) ? *this : persistent_hash_set(trie.insert(key));
+    }
+
+    persistent_hash_set erase(const K& key) const
+    {
+        return persistent_hash_set(trie.erase(key));
+    }
+
+    template <typename F>
+    void for_each(F&& f) const
+    {
+        trie.for_each(f);
+    }
+
+    // seed plus the sum of key_hash over all keys, kept in the root node; key_hash must not vary
+    template <typename F>
+    size_type cached_hash(size_type seed, F key_hash) const
+    {
+        return trie.cached_sum(seed, key_hash);
+    }
+
+    friend bool operator==(const persistent_hash_set& left, const persistent_hash_set& right)
+    {
+        if (left.size() != right.size())
+            return false;
+        if (left.trie.shares_root_with(right.trie))
+            return true;
+        bool equal = true;
+        left.for_each([&](const K& k) { equal = equal && right.contains(k); });
+        return equal;
+    }
+
+    friend bool operator!=(const persistent_hash_set& left, const persistent_hash_set& right)
+    {
+        return !(left == right);
+    }
+
+private:
+    using trie_type = detail::hash_trie<K, K, detail::identity_key, Hash, KeyEqual>;
+
+    trie_type trie;
+
+    explicit persistent_hash_set(trie_type trie) : trie(std::move(trie)) { }
+};
+
+}
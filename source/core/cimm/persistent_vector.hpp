@@ -1,16 +1,34 @@
 #pragma once
+#include <algorithm>
 #include <cstddef>
 #include <initializer_list>
+#include <iterator>
 #include <stdexcept>
 #include <array>
 #include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "pool.hpp"
+#include "ref_count.hpp"
 
 namespace cimm
 {
 
+template <typename T, unsigned short log_num_branches>
+class transient_vector;
+
 namespace detail
 {
 
+using edit_token = std::uint64_t;
+
+inline edit_token new_edit_token()
+{
+    static std::atomic<edit_token> next{1};
+    return next++;
+}
+
 template <typename T, unsigned short log_num_branches>
 class persistent_vector_common
 {
@@ -40,7 +58,7 @@ protected:
         ptr(ptr<U>&& other) { std::swap(p, other.p); }
 
         template <typename X>
-        ptr(const ptr<X>& other) : p(&*other) { if (p) ++p->refCount; }
+        ptr(const ptr<X>& other) : p(other ? &*other : nullptr) { if (p) ++p->refCount; }
 
         ptr<U>& operator=(ptr<U> other)
         {
@@ -51,13 +69,22 @@ protected:
         ~ptr()
         {
             if (p && !--p->refCount)
-                delete p;
+                destroy(p);
         }
 
         template <typename... Args>
         static ptr<U> make(Args&&... args)
         {
-            return ptr<U>{new U{std::forward<Args>(args)...}};
+            auto block = pool_for<U>::allocate();
+            try
+            {
+                return ptr<U>{new (block) U{std::forward<Args>(args)...}};
+            }
+            catch (...)
+            {
+                pool_for<U>::deallocate(block);
+                throw;
+            }
         }
 
         explicit operator bool() const { return p; }
@@ -72,12 +99,16 @@ protected:
 
     struct element
     {
-        std::atomic<size_type> refCount{1};
-        virtual ~element() noexcept = default;
+        reference_count refCount{1};
+        bool is_leaf = false;
+        mutable std::atomic<bool> folded{false};
+        edit_token edit = 0;
+        mutable std::atomic<std::size_t> fold{0};
     };
 
     struct node : element
     {
+        std::unique_ptr<size_type[]> sizes;
         std::array<ptr<element>, num_branches> elems;
 
         node() = default;
@@ -111,8 +142,12 @@ protected:
     class leaf : public element
     {
     public:
-        leaf() = default;
-        leaf(const value_type& elem)
+        leaf()
+        {
+            this->is_leaf = true;
+        }
+
+        leaf(const value_type& elem) : leaf()
         {
             push_back(elem);
         }
@@ -131,6 +166,14 @@ protected:
             ++count;
         }
 
+        void push_back(value_type&& elem)
+        {
+            if (count == num_branches)
+                throw std::out_of_range("leaf push_back full");
+            new(elems + count) value_type(std::move(elem));
+            ++count;
+        }
+
         ptr<leaf> push_back_new(const value_type& elem) const
         {
             auto p = ptr<leaf>::make();
@@ -141,6 +184,14 @@ protected:
             return p;
         }
 
+        void pop_back()
+        {
+            if (count == 0)
+                throw std::out_of_range("leaf pop_back empty");
+            --count;
+            reinterpret_cast<value_type *>(elems + count)->~value_type();
+        }
+
         ptr<leaf> pop_back_new() const
         {
             if (count == 0)
@@ -152,48 +203,145 @@ protected:
             return p;
         }
 
+        // Unchecked like operator[]; at() and the nth built-in validate indexes first
         const value_type& get(size_type index) const
         {
-            if (index >= count)
-                throw std::out_of_range("leaf get out of range");
-            return *reinterpret_cast<const value_type *>(elems + index); }
+            return data()[index];
+        }
+
+        const value_type *data() const
+        {
+            return reinterpret_cast<const value_type *>(elems);
+        }
+
+        size_type size() const { return count; }
     private:
-        typename std::aligned_storage<sizeof(value_type), alignof(value_type)>::type elems[num_branches];
         size_type count = 0;
+        typename std::aligned_storage<sizeof(value_type), alignof(value_type)>::type elems[num_branches];
     };
 
+    template <typename U>
+    static void destroy(U *e)
+    {
+        e->~U();
+        pool_for<U>::deallocate(e);
+    }
+
+    static void destroy(element *e)
+    {
+        if (e->is_leaf)
+            destroy(static_cast<leaf *>(e));
+        else
+            destroy(static_cast<node *>(e));
+    }
+
     static const leaf& as_leaf(const ptr<element>& e)
     {
-        if (!e)
-            throw std::invalid_argument("leaf element is null");
-        return dynamic_cast<const leaf&>(*e);
+        return static_cast<const leaf&>(*e);
     }
 
     static const node& as_node(const ptr<element>& e)
     {
-        if (!e)
-            throw std::invalid_argument("node element is null");
-        return dynamic_cast<const node&>(*e);
+        return static_cast<const node&>(*e);
     }
 
-    static ptr<element> push_back_leaf(const ptr<element> parent, const T& elem, size_type index, size_type shift)
+    static ptr<element> new_path(ptr<element> e, size_type shift)
     {
-        if (!parent)
-            return create_element(elem, shift);
         if (shift == 0)
-            return as_leaf(parent).push_back_new(elem);
+            return e;
+        return ptr<node>::make(new_path(std::move(e), shift - log_num_branches));
+    }
+
+    static ptr<element> push_tail(const ptr<element>& parent, ptr<element> tail, size_type index, size_type shift)
+    {
         auto& parent_node = as_node(parent);
         auto node_index = local_index(index, shift);
-        return parent_node.replace_new(node_index, push_back_leaf(parent_node.elems.at(node_index), elem, index, shift - log_num_branches));
+        auto& child = parent_node.elems[node_index];
+        if (shift == log_num_branches)
+            return parent_node.replace_new(node_index, std::move(tail));
+        if (!child)
+            return parent_node.replace_new(node_index, new_path(std::move(tail), shift - log_num_branches));
+        return parent_node.replace_new(node_index, push_tail(child, std::move(tail), index, shift - log_num_branches));
     }
 
-    static ptr<element> pop_back_leaf(const ptr<element> parent, size_type index, size_type shift)
+    static ptr<element> pop_tail(const ptr<element>& parent, size_type index, size_type shift)
     {
-        if (shift == 0)
-            return as_leaf(parent).pop_back_new();
         auto& parent_node = as_node(parent);
         auto node_index = local_index(index, shift);
-        return parent_node.replace_new(node_index, pop_back_leaf(parent_node.elems.at(node_index), index, shift - log_num_branches));
+        if (shift == log_num_branches)
+            return parent_node.replace_new(node_index, nullptr);
+        return parent_node.replace_new(node_index, pop_tail(parent_node.elems[node_index], index, shift - log_num_branches));
+    }
+
+    static const ptr<element>& leaf_at(const ptr<element>& elem, size_type index, size_type shift)
+    {
+        if (shift == 0)
+            return elem;
+        return leaf_at(as_node(elem).elems[local_index(index, shift)], index, shift - log_num_branches);
+    }
+
+    static leaf& editable_leaf(ptr<element>& e, edit_token edit)
+    {
+        auto& current = as_leaf(e);
+        if (current.edit != edit)
+        {
+            auto copy = ptr<leaf>::make();
+            for (size_type i = 0; i < current.size(); ++i)
+                (*copy).push_back(current.get(i));
+            (*copy).edit = edit;
+            e = std::move(copy);
+        }
+        return static_cast<leaf&>(*e);
+    }
+
+    static node& editable_node(ptr<element>& e, edit_token edit)
+    {
+        auto& current = as_node(e);
+        if (current.edit != edit)
+        {
+            auto copy = ptr<node>::make();
+            (*copy).elems = current.elems;
+            if (current.sizes)
+            {
+                (*copy).sizes.reset(new size_type[num_branches]);
+                std::copy(current.sizes.get(), current.sizes.get() + num_branches, (*copy).sizes.get());
+            }
+            (*copy).edit = edit;
+            e = std::move(copy);
+        }
+        return static_cast<node&>(*e);
+    }
+
+    static ptr<element> new_editable_path(ptr<element> e, size_type shift, edit_token edit)
+    {
+        if (shift == 0)
+            return e;
+        auto n = ptr<node>::make(new_editable_path(std::move(e), shift - log_num_branches, edit));
+        (*n).edit = edit;
+        return n;
+    }
+
+    static void push_tail_in_place(ptr<element>& parent, ptr<element> tail, size_type index, size_type shift, edit_token edit)
+    {
+        auto& parent_node = editable_node(parent, edit);
+        auto& child = parent_node.elems[local_index(index, shift)];
+        if (shift == log_num_branches)
+            child = std::move(tail);
+        else if (!child)
+            child = new_editable_path(std::move(tail), shift - log_num_branches, edit);
+        else
+            push_tail_in_place(child, std::move(tail), index, shift - log_num_branches, edit);
+    }
+
+    static bool pop_tail_in_place(ptr<element>& parent, size_type index, size_type shift, edit_token edit)
+    {
+        auto& parent_node = editable_node(parent, edit);
+        auto node_index = local_index(index, shift);
+        auto& child = parent_node.elems[node_index];
+        if (shift > log_num_branches && !pop_tail_in_place(child, index, shift - log_num_branches, edit))
+            return false;
+        child = nullptr;
+        return node_index == 0;
     }
 
     static size_type local_index(size_type index, size_type shift = 0)
@@ -201,21 +349,452 @@ protected:
         return (index >> shift) & index_mask;
     }
 
-    const value_type& get(const ptr<element>& elem, size_type index, size_type shift) const
+    template <typename ForwardIterator>
+    static ptr<element> build_leaf(ForwardIterator& first, size_type n)
+    {
+        auto l = ptr<leaf>::make();
+        for (size_type i = 0; i < n; ++i, ++first)
+            (*l).push_back(*first);
+        return l;
+    }
+
+    template <typename ForwardIterator>
+    static ptr<element> build_tree(ForwardIterator& first, size_type n, size_type& shift)
+    {
+        shift = 0;
+        if (n == 0)
+            return nullptr;
+        std::vector<ptr<element>> level;
+        level.reserve(n / num_branches);
+        for (size_type i = 0; i < n; i += num_branches)
+            level.push_back(build_leaf(first, num_branches));
+        for (; level.size() > 1; shift += log_num_branches)
+        {
+            std::vector<ptr<element>> parents;
+            parents.reserve((level.size() + index_mask) / num_branches);
+            for (size_type i = 0; i < level.size(); i += num_branches)
+            {
+                auto p = ptr<node>::make();
+                for (size_type k = 0; k < num_branches && i + k < level.size(); ++k)
+                    (*p).elems[k] = std::move(level[i + k]);
+                parents.push_back(std::move(p));
+            }
+            level = std::move(parents);
+        }
+        return std::move(level.front());
+    }
+
+    static size_type child_index(const node& n, size_type& index, size_type shift)
+    {
+        auto i = index >> shift;
+        if (n.sizes)
+        {
+            while (n.sizes[i] <= index)
+                ++i;
+            if (i > 0)
+                index -= n.sizes[i - 1];
+        }
+        else
+            index -= i << shift;
+        return i;
+    }
+
+    static const leaf& leaf_for(const ptr<element>& root, size_type& index, size_type shift)
+    {
+        const element *e = &*root;
+        if (!is_relaxed(root))
+        {
+            for (; shift > 0; shift -= log_num_branches)
+                e = &*static_cast<const node *>(e)->elems[local_index(index, shift)];
+            index = local_index(index);
+            return *static_cast<const leaf *>(e);
+        }
+        for (; shift > 0; shift -= log_num_branches)
+        {
+            auto& n = *static_cast<const node *>(e);
+            e = &*n.elems[child_index(n, index, shift)];
+        }
+        return *static_cast<const leaf *>(e);
+    }
+
+    static const value_type& get(const ptr<element>& root, size_type index, size_type shift)
+    {
+        auto& l = leaf_for(root, index, shift);
+        return l.get(index);
+    }
+
+    static bool is_relaxed(const ptr<element>& e)
+    {
+        return !(*e).is_leaf && as_node(e).sizes;
+    }
+
+    static bool is_dense(const ptr<element>& root, size_type size)
+    {
+        return size % num_branches == 0 && !is_relaxed(root);
+    }
+
+    static size_type num_children(const node& n)
+    {
+        size_type first = 1, last = num_branches;
+        while (first < last)
+        {
+            auto middle = (first + last) / 2;
+            if (n.elems[middle])
+                first = middle + 1;
+            else
+                last = middle;
+        }
+        return first;
+    }
+
+    static std::vector<ptr<element>> children(const ptr<element>& e)
+    {
+        auto& n = as_node(e);
+        return std::vector<ptr<element>>(n.elems.begin(), n.elems.begin() + num_children(n));
+    }
+
+    static size_type size_of(const ptr<element>& e, size_type shift)
     {
         if (shift == 0)
-            return as_leaf(elem).get(local_index(index));
-        return get(as_node(elem).elems.at(local_index(index, shift)), index, shift - log_num_branches);
+            return as_leaf(e).size();
+        auto& n = as_node(e);
+        auto count = num_children(n);
+        if (n.sizes)
+            return n.sizes[count - 1];
+        return ((count - 1) << shift) + size_of(n.elems[count - 1], shift - log_num_branches);
+    }
+
+    static ptr<element> make_node(std::vector<ptr<element>> children, size_type shift)
+    {
+        auto p = ptr<node>::make();
+        auto& n = *p;
+        std::array<size_type, num_branches> sizes;
+        auto balanced = true;
+        size_type total = 0;
+        for (size_type i = 0; i < children.size(); ++i)
+        {
+            auto size = size_of(children[i], shift - log_num_branches);
+            if (is_relaxed(children[i]) || (i + 1 < children.size() && size != (size_type(1) << shift)))
+                balanced = false;
+            total += size;
+            sizes[i] = total;
+            n.elems[i] = std::move(children[i]);
+        }
+        if (!balanced)
+        {
+            n.sizes.reset(new size_type[num_branches]);
+            std::copy(sizes.begin(), sizes.begin() + children.size(), n.sizes.get());
+        }
+        return p;
+    }
+
+    static ptr<element> append_leaf(const ptr<element>& e, size_type shift, const ptr<element>& l)
+    {
+        auto c = children(e);
+        if (shift > log_num_branches)
+        {
+            if (auto last = append_leaf(c.back(), shift - log_num_branches, l))
+            {
+                c.back() = std::move(last);
+                return make_node(std::move(c), shift);
+            }
+        }
+        if (c.size() == num_branches)
+            return nullptr;
+        c.push_back(new_path(l, shift - log_num_branches));
+        return make_node(std::move(c), shift);
+    }
+
+    static ptr<element> push_leaf(const ptr<element>& root, size_type& shift, const ptr<element>& l)
+    {
+        if (!root)
+        {
+            shift = 0;
+            return l;
+        }
+        if (shift > 0)
+            if (auto appended = append_leaf(root, shift, l))
+                return appended;
+        shift += log_num_branches;
+        return make_node({root, new_path(l, shift - log_num_branches)}, shift);
+    }
+
+    static ptr<element> pop_leaf(const ptr<element>& e, size_type shift, ptr<element>& popped)
+    {
+        if (shift == 0)
+        {
+            popped = e;
+            return nullptr;
+        }
+        auto c = children(e);
+        if (auto last = pop_leaf(c.back(), shift - log_num_branches, popped))
+            c.back() = std::move(last);
+        else
+            c.pop_back();
+        if (c.empty())
+            return nullptr;
+        return make_node(std::move(c), shift);
+    }
+
+    static void collapse(ptr<element>& root, size_type& shift)
+    {
+        if (!root)
+            shift = 0;
+        for (; shift > 0 && !as_node(root).elems[1]; shift -= log_num_branches)
+            root = as_node(root).elems[0];
+    }
+
+    static ptr<element> take(const ptr<element>& e, size_type shift, size_type n)
+    {
+        if (shift == 0)
+        {
+            auto& l = as_leaf(e);
+            if (n == l.size())
+                return e;
+            auto p = ptr<leaf>::make();
+            for (size_type i = 0; i < n; ++i)
+                (*p).push_back(l.get(i));
+            return p;
+        }
+        auto& parent = as_node(e);
+        auto index = n - 1;
+        auto i = child_index(parent, index, shift);
+        std::vector<ptr<element>> c(parent.elems.begin(), parent.elems.begin() + i);
+        c.push_back(take(parent.elems[i], shift - log_num_branches, index + 1));
+        return make_node(std::move(c), shift);
+    }
+
+    static ptr<element> drop(const ptr<element>& e, size_type shift, size_type n)
+    {
+        if (n == 0)
+            return e;
+        if (shift == 0)
+        {
+            auto& l = as_leaf(e);
+            auto p = ptr<leaf>::make();
+            for (size_type i = n; i < l.size(); ++i)
+                (*p).push_back(l.get(i));
+            return p;
+        }
+        auto& parent = as_node(e);
+        auto i = child_index(parent, n, shift);
+        std::vector<ptr<element>> c{drop(parent.elems[i], shift - log_num_branches, n)};
+        c.insert(c.end(), parent.elems.begin() + i + 1, parent.elems.begin() + num_children(parent));
+        return make_node(std::move(c), shift);
+    }
+
+    static size_type num_slots(const ptr<element>& e, size_type shift)
+    {
+        return shift == 0 ? as_leaf(e).size() : num_children(as_node(e));
+    }
+
+    static std::vector<size_type> concat_plan(const std::vector<ptr<element>>& c, size_type shift)
+    {
+        const size_type extra_steps = 2;
+        std::vector<size_type> sizes;
+        size_type total = 0;
+        for (auto& e : c)
+        {
+            sizes.push_back(num_slots(e, shift));
+            total += sizes.back();
+        }
+        auto optimal = (total + num_branches - 1) / num_branches;
+        auto n = sizes.size();
+        size_type i = 0;
+        while (optimal + extra_steps < n)
+        {
+            while (sizes[i] > num_branches - extra_steps / 2)
+                ++i;
+            auto remaining = sizes[i];
+            do
+            {
+                auto size = remaining + sizes[i + 1];
+                if (size > num_branches)
+                    size = num_branches;
+                remaining = remaining + sizes[i + 1] - size;
+                sizes[i] = size;
+                ++i;
+            }
+            while (remaining > 0);
+            for (auto j = i; j < n - 1; ++j)
+                sizes[j] = sizes[j + 1];
+            --n;
+            --i;
+        }
+        sizes.resize(n);
+        return sizes;
+    }
+
+    static std::vector<ptr<element>> rebalance(const std::vector<ptr<element>>& c, size_type shift)
+    {
+        auto child_shift = shift - log_num_branches;
+        std::vector<ptr<element>> result;
+        size_type from = 0, offset = 0;
+        for (auto size : concat_plan(c, child_shift))
+        {
+            if (offset == 0 && num_slots(c[from], child_shift) == size)
+            {
+                result.push_back(c[from++]);
+                continue;
+            }
+            if (child_shift == 0)
+            {
+                auto p = ptr<leaf>::make();
+                while ((*p).size() < size)
+                {
+                    auto& l = as_leaf(c[from]);
+                    (*p).push_back(l.get(offset++));
+                    if (offset == l.size())
+                        ++from, offset = 0;
+                }
+                result.push_back(std::move(p));
+            }
+            else
+            {
+                std::vector<ptr<element>> grandchildren;
+                while (grandchildren.size() < size)
+                {
+                    auto& n = as_node(c[from]);
+                    grandchildren.push_back(n.elems[offset++]);
+                    if (offset == num_children(n))
+                        ++from, offset = 0;
+                }
+                result.push_back(make_node(std::move(grandchildren), child_shift));
+            }
+        }
+        if (result.size() <= num_branches)
+            return {make_node(std::move(result), shift)};
+        return {
+            make_node(std::vector<ptr<element>>(result.begin(), result.begin() + num_branches), shift),
+            make_node(std::vector<ptr<element>>(result.begin() + num_branches, result.end()), shift)};
     }
 
-    static ptr<element> create_element(const value_type& elem, size_type shift)
+    static std::vector<ptr<element>> merge_leaves(const ptr<element>& left, const ptr<element>& right)
+    {
+        auto& l = as_leaf(left);
+        auto& r = as_leaf(right);
+        if (l.size() == num_branches)
+            return {left, right};
+        auto first = ptr<leaf>::make();
+        auto second = ptr<leaf>::make();
+        for (size_type i = 0; i < l.size(); ++i)
+            (*first).push_back(l.get(i));
+        for (size_type i = 0; i < r.size(); ++i)
+            ((*first).size() < num_branches ? *first : *second).push_back(r.get(i));
+        if ((*second).size() == 0)
+            return {std::move(first)};
+        return {std::move(first), std::move(second)};
+    }
+
+    static std::vector<ptr<element>> merge(const ptr<element>& left, size_type left_shift, const ptr<element>& right, size_type right_shift)
+    {
+        if (left_shift > right_shift)
+        {
+            auto c = children(left);
+            auto middle = merge(c.back(), left_shift - log_num_branches, right, right_shift);
+            c.pop_back();
+            c.insert(c.end(), middle.begin(), middle.end());
+            return rebalance(c, left_shift);
+        }
+        if (left_shift < right_shift)
+        {
+            auto c = children(right);
+            auto middle = merge(left, left_shift, c.front(), right_shift - log_num_branches);
+            middle.insert(middle.end(), c.begin() + 1, c.end());
+            return rebalance(middle, right_shift);
+        }
+        if (left_shift == 0)
+            return merge_leaves(left, right);
+        auto c = children(left);
+        auto right_children = children(right);
+        auto middle = merge(c.back(), left_shift - log_num_branches, right_children.front(), right_shift - log_num_branches);
+        c.pop_back();
+        c.insert(c.end(), middle.begin(), middle.end());
+        c.insert(c.end(), right_children.begin() + 1, right_children.end());
+        return rebalance(c, left_shift);
+    }
+
+    template <typename F>
+    static void for_each_chunk(const ptr<element>& e, size_type shift, F& f)
     {
         if (shift == 0)
-            return ptr<leaf>::make(elem);
-        return ptr<node>::make(create_element(elem, shift - log_num_branches));
+        {
+            auto& l = as_leaf(e);
+            f(l.data(), l.data() + l.size());
+            return;
+        }
+        for (auto& child : as_node(e).elems)
+        {
+            if (!child)
+                break;
+            for_each_chunk(child, shift - log_num_branches, f);
+        }
+    }
+
+    template <typename Vector>
+    static bool equal(const Vector& left, const Vector& right)
+    {
+        if (left.size() != right.size())
+            return false;
+        for (size_type i = 0; i < left.size();)
+        {
+            size_type left_first, left_last, right_first, right_last;
+            auto l = left.chunk_for(i, left_first, left_last) + (i - left_first);
+            auto r = right.chunk_for(i, right_first, right_last) + (i - right_first);
+            auto last = std::min(left_last, right_last);
+            if (l != r && !std::equal(l, l + (last - i), r))
+                return false;
+            i = last;
+        }
+        return true;
     }
 };
 
+template <typename Vector, typename T, unsigned short log_num_branches>
+class chunked_iterator : public std::iterator<std::random_access_iterator_tag, const T, std::ptrdiff_t>
+{
+public:
+    using size_type = std::size_t;
+    using difference_type = std::ptrdiff_t;
+    using reference = const T&;
+    using pointer = const T *;
+
+    chunked_iterator(const Vector& container, size_type index)
+        : container(&container), index(index) { }
+    friend bool operator==(const chunked_iterator& left, const chunked_iterator& right) { return left.index == right.index; }
+    friend bool operator!=(const chunked_iterator& left, const chunked_iterator& right) { return !(left == right); }
+    friend difference_type operator-(const chunked_iterator& left, const chunked_iterator& right)
+    {
+        return left.index - right.index;
+    }
+    chunked_iterator& operator+=(difference_type n) { index += n; return *this; }
+    friend chunked_iterator operator+(chunked_iterator left, difference_type right) { return left += right; }
+    chunked_iterator& operator-=(difference_type n) { index -= n; return *this; }
+    friend chunked_iterator operator-(chunked_iterator left, difference_type right) { return left -= right; }
+    chunked_iterator& operator++() { ++index; return *this; }
+    chunked_iterator operator++(int) { auto prev = *this; ++*this; return prev; }
+    chunked_iterator& operator--() { --index; return *this; }
+    chunked_iterator operator--(int) { auto prev = *this; --*this; return prev; }
+    reference operator*() const
+    {
+        if (index - chunk_first >= chunk_size)
+        {
+            size_type chunk_last;
+            chunk = container->chunk_for(index, chunk_first, chunk_last);
+            chunk_size = chunk_last - chunk_first;
+        }
+        return chunk[index - chunk_first];
+    }
+    pointer operator->() const { return &**this; }
+    reference operator[](difference_type index) const { return *(*this + index); }
+private:
+    const Vector *container;
+    size_type index;
+    mutable const T *chunk = nullptr;
+    mutable size_type chunk_first = 0;
+    mutable size_type chunk_size = 0;
+};
+
 }
 
 template <typename T, unsigned short log_num_branches = 5>
@@ -231,45 +810,14 @@ public:
     using reference = const_reference;
     using pointer = const value_type *;
 
-    class const_iterator : public std::iterator<std::random_access_iterator_tag, const value_type, difference_type>
-    {
-    public:
-        const_iterator(const persistent_vector<T, log_num_branches>& container, size_type index)
-            : container(&container), index(index) { }
-        friend bool operator==(const const_iterator& left, const const_iterator& right) { return left.index == right.index; }
-        friend bool operator!=(const const_iterator& left, const const_iterator& right) { return !(left == right); }
-        friend difference_type operator-(const const_iterator& left, const const_iterator& right)
-        {
-            return left.index - right.index;
-        }
-        const_iterator& operator+=(difference_type n) { index += n; return *this; }
-        friend const_iterator operator+(const_iterator left, difference_type right) { return left += right; }
-        const_iterator& operator-=(difference_type n) { index -= n; return *this; }
-        friend const_iterator operator-(const_iterator left, difference_type right) { return left -= right; }
-        const_iterator& operator++() { ++index; return *this; }
-        const_iterator operator++(int) { auto prev = *this; ++*this; return prev; }
-        const_iterator& operator--() { --index; return *this; }
-        const_iterator operator--(int) { auto prev = *this; --*this; return prev; }
-        reference operator*() const { return (*container)[index]; }
-        pointer operator->() const { return &**this; }
-        reference operator[](difference_type index) const { return *(*this + index); }
-    private:
-        const persistent_vector<T, log_num_branches> *container;
-        size_type index;
-    };
-
+    using const_iterator = detail::chunked_iterator<persistent_vector, T, log_num_branches>;
     using iterator = const_iterator;
 
     persistent_vector() = default;
 
     template <typename InputIterator>
     persistent_vector(InputIterator first, InputIterator last)
-    {
-        persistent_vector<T, log_num_branches> v;
-        for (; first != last; ++first)
-            v = v.push_back(*first);
-        *this = std::move(v);
-    }
+        : persistent_vector(first, last, typename std::iterator_traits<InputIterator>::iterator_category{}) { }
 
     persistent_vector(const std::initializer_list<T>& elems) : persistent_vector(std::begin(elems), std::end(elems)) { }
 
@@ -284,6 +832,9 @@ public:
 
     const_reference operator[](size_type index) const
     {
+        auto offset = tail_offset();
+        if (index >= offset)
+            return base::as_leaf(tail).get(index - offset);
         return base::get(root, index, shift);
     }
 
@@ -300,28 +851,165 @@ public:
     const_iterator begin() const { return {*this, 0}; }
     const_iterator end() const { return {*this, count}; }
 
-    persistent_vector insert(const_iterator pos, const T& value) const;
+    friend bool operator==(const persistent_vector& left, const persistent_vector& right)
+    {
+        return base::equal(left, right);
+    }
+
+    template <typename F>
+    void for_each_chunk(F f) const
+    {
+        if (root)
+            base::for_each_chunk(root, shift, f);
+        if (tail)
+        {
+            auto& tail_leaf = base::as_leaf(tail);
+            f(tail_leaf.data(), tail_leaf.data() + tail_leaf.size());
+        }
+    }
+
+    // Left fold of the elements starting from seed. The fold of the elements in the tree is kept in its root
+    // node and reused by every vector sharing that root, so all calls for a given T must pass the same seed and combine.
+    template <typename F>
+    std::size_t cached_fold(std::size_t seed, F combine) const
+    {
+        auto h = seed;
+        if (root)
+        {
+            auto& r = *root;
+            if (!r.folded.load(std::memory_order_acquire))
+            {
+                auto fold_chunk = [&](pointer first, pointer last)
+                {
+                    for (; first != last; ++first)
+                        h = combine(h, *first);
+                };
+                base::for_each_chunk(root, shift, fold_chunk);
+                r.fold.store(h, std::memory_order_relaxed);
+                r.folded.store(true, std::memory_order_release);
+            }
+            h = r.fold.load(std::memory_order_relaxed);
+        }
+        if (tail)
+        {
+            auto& tail_leaf = base::as_leaf(tail);
+            for (auto e = tail_leaf.data(); e != tail_leaf.data() + tail_leaf.size(); ++e)
+                h = combine(h, *e);
+        }
+        return h;
+    }
+
+    persistent_vector insert(const_iterator pos, const T& value) const
+    {
+        auto index = size_type(pos - begin());
+        return slice(0, index).push_back(value).concat(slice(index, count));
+    }
+
     template <typename InputIterator>
-    persistent_vector insert(const_iterator pos, InputIterator first, InputIterator last) const;
+    persistent_vector insert(const_iterator pos, InputIterator first, InputIterator last) const
+    {
+        auto index = size_type(pos - begin());
+        return slice(0, index).concat(persistent_vector(first, last)).concat(slice(index, count));
+    }
 
-    persistent_vector erase(const_iterator pos) const;
-    persistent_vector erase(const_iterator first, const_iterator last) const;
+    persistent_vector erase(const_iterator pos) const
+    {
+        return erase(pos, pos + 1);
+    }
 
-    persistent_vector push_back(const T& elem) const
+    persistent_vector erase(const_iterator first, const_iterator last) const
+    {
+        return slice(0, first - begin()).concat(slice(last - begin(), count));
+    }
+
+    persistent_vector slice(size_type first, size_type last) const
+    {
+        if (first > last || last > count)
+            throw std::out_of_range("persistent_vector: slice out of range");
+        if (first == last)
+            return {};
+        if (first == 0 && last == count)
+            return *this;
+        auto offset = tail_offset();
+        if (first >= offset)
+            return persistent_vector{nullptr, base::drop(base::take(tail, 0, last - offset), 0, first - offset), last - first, 0};
+        auto tree_shift = shift;
+        if (last > offset)
+        {
+            auto new_root = base::drop(root, tree_shift, first);
+            base::collapse(new_root, tree_shift);
+            return persistent_vector{std::move(new_root), base::take(tail, 0, last - offset), last - first, tree_shift};
+        }
+        auto tree = base::drop(base::take(root, tree_shift, last), tree_shift, first);
+        return from_tree(std::move(tree), tree_shift, last - first);
+    }
+
+    persistent_vector concat(const persistent_vector& other) const
     {
-        if (count == (num_branches << shift))
+        if (other.empty())
+            return *this;
+        if (empty())
+            return other;
+        if (!other.root)
         {
-            return persistent_vector{ptr<node>::make(root, base::create_element(elem, shift)), count + 1, shift + log_num_branches};
+            auto v = *this;
+            for (auto& e : other)
+                v = v.push_back(e);
+            return v;
         }
+        auto left_shift = shift;
+        auto left = base::push_leaf(root, left_shift, tail);
+        auto right_shift = other.shift;
+        auto right = base::push_leaf(other.root, right_shift, other.tail);
+        auto merged = base::merge(left, left_shift, right, right_shift);
+        auto merged_shift = std::max(left_shift, right_shift);
+        if (merged.size() == 1)
+            return from_tree(std::move(merged.front()), merged_shift, count + other.count);
+        merged_shift += log_num_branches;
+        return from_tree(base::make_node(merged, merged_shift), merged_shift, count + other.count);
+    }
 
-        return persistent_vector{base::push_back_leaf(root, elem, count, shift), count + 1, shift};
+    persistent_vector push_back(const T& elem) const
+    {
+        if (!tail)
+            return persistent_vector{root, ptr<leaf>::make(elem), count + 1, shift};
+        auto& tail_leaf = base::as_leaf(tail);
+        if (tail_leaf.size() < num_branches)
+            return persistent_vector{root, tail_leaf.push_back_new(elem), count + 1, shift};
+
+        auto offset = tail_offset();
+        if (!root)
+            return persistent_vector{tail, ptr<leaf>::make(elem), count + 1, 0};
+        if (!base::is_dense(root, offset))
+        {
+            auto new_shift = shift;
+            auto new_root = base::push_leaf(root, new_shift, tail);
+            return persistent_vector{std::move(new_root), ptr<leaf>::make(elem), count + 1, new_shift};
+        }
+        if (offset == (num_branches << shift))
+            return persistent_vector{ptr<node>::make(root, base::new_path(tail, shift)), ptr<leaf>::make(elem), count + 1, shift + log_num_branches};
+        return persistent_vector{base::push_tail(root, tail, offset, shift), ptr<leaf>::make(elem), count + 1, shift};
     }
 
     persistent_vector pop_back() const
     {
-        if (count == (num_branches << shift) + 1)
-            return persistent_vector{base::as_node(root).elems[0], count - 1, shift - log_num_branches};
-        return persistent_vector{base::pop_back_leaf(root, count - 1, shift), count - 1, shift};
+        if (count == 0)
+            throw std::out_of_range("persistent_vector: pop_back on an empty vector");
+        auto& tail_leaf = base::as_leaf(tail);
+        if (tail_leaf.size() > 1)
+            return persistent_vector{root, tail_leaf.pop_back_new(), count - 1, shift};
+        if (count == 1)
+            return {};
+
+        if (!base::is_dense(root, tail_offset()))
+            return from_tree(root, shift, count - 1);
+        auto new_tail = base::leaf_at(root, count - 2, shift);
+        if (shift == 0)
+            return persistent_vector{nullptr, std::move(new_tail), count - 1, 0};
+        auto new_root = base::pop_tail(root, count - 2, shift);
+        if (!base::as_node(new_root).elems[1])
+            return persistent_vector{base::as_node(new_root).elems[0], std::move(new_tail), count - 1, shift - log_num_branches};
+        return persistent_vector{std::move(new_root), std::move(new_tail), count - 1, shift};
     }
 
 private:
@@ -335,18 +1023,62 @@ private:
     template <typename U>
     using ptr = typename base::template ptr<U>;
 
-    ptr<element> root;
+    ptr<element> root, tail;
     size_type count = 0;
     size_type shift = 0;
 
-    persistent_vector(ptr<element> root, size_type count, size_type shift) : root(std::move(root)), count(count), shift(shift) { }
-};
+    persistent_vector(ptr<element> root, ptr<element> tail, size_type count, size_type shift)
+        : root(std::move(root)), tail(std::move(tail)), count(count), shift(shift) { }
 
-template <typename T, unsigned short log_num_branches>
-inline bool operator==(const persistent_vector<T, log_num_branches>& left, const persistent_vector<T, log_num_branches>& right)
-{
-    return left.size() == right.size() && std::equal(left.begin(), left.end(), right.begin());
-}
+    template <typename InputIterator>
+    persistent_vector(InputIterator first, InputIterator last, std::input_iterator_tag)
+        : persistent_vector(transient_vector<T, log_num_branches>(first, last).persistent()) { }
+
+    template <typename ForwardIterator>
+    persistent_vector(ForwardIterator first, ForwardIterator last, std::forward_iterator_tag)
+        : count(std::distance(first, last))
+    {
+        if (count == 0)
+            return;
+        auto tail_size = ((count - 1) & index_mask) + 1;
+        root = base::build_tree(first, count - tail_size, shift);
+        tail = base::build_leaf(first, tail_size);
+    }
+
+    static persistent_vector from_tree(const ptr<element>& tree, size_type shift, size_type count)
+    {
+        ptr<element> new_tail;
+        auto new_root = base::pop_leaf(tree, shift, new_tail);
+        base::collapse(new_root, shift);
+        return persistent_vector{std::move(new_root), std::move(new_tail), count, shift};
+    }
+
+    friend class transient_vector<T, log_num_branches>;
+
+    friend class detail::chunked_iterator<persistent_vector, T, log_num_branches>;
+    friend class detail::persistent_vector_common<T, log_num_branches>;
+
+    const value_type *chunk_for(size_type index, size_type& first, size_type& last) const
+    {
+        auto offset = tail_offset();
+        if (index >= offset)
+        {
+            first = offset;
+            last = count;
+            return base::as_leaf(tail).data();
+        }
+        auto local = index;
+        auto& l = base::leaf_for(root, local, shift);
+        first = index - local;
+        last = first + l.size();
+        return l.data();
+    }
+
+    size_type tail_offset() const
+    {
+        return tail ? count - base::as_leaf(tail).size() : 0;
+    }
+};
 
 template <typename T, unsigned short log_num_branches>
 inline bool operator!=(const persistent_vector<T, log_num_branches>& left, const persistent_vector<T, log_num_branches>& right)
@@ -367,33 +1099,7 @@ public:
     using reference = const_reference;
     using pointer = const value_type *;
 
-    class const_iterator : public std::iterator<std::random_access_iterator_tag, const value_type, difference_type>
-    {
-    public:
-        const_iterator(const transient_vector<T, log_num_branches>& container, size_type index)
-            : container(&container), index(index) { }
-        friend bool operator==(const const_iterator& left, const const_iterator& right) { return left.index == right.index; }
-        friend bool operator!=(const const_iterator& left, const const_iterator& right) { return !(left == right); }
-        friend difference_type operator-(const const_iterator& left, const const_iterator& right)
-        {
-            return left.index - right.index;
-        }
-        const_iterator& operator+=(difference_type n) { index += n; return *this; }
-        friend const_iterator operator+(const_iterator left, difference_type right) { return left += right; }
-        const_iterator& operator-=(difference_type n) { index -= n; return *this; }
-        friend const_iterator operator-(const_iterator left, difference_type right) { return left -= right; }
-        const_iterator& operator++() { ++index; return *this; }
-        const_iterator operator++(int) { auto prev = *this; ++*this; return prev; }
-        const_iterator& operator--() { --index; return *this; }
-        const_iterator operator--(int) { auto prev = *this; --*this; return prev; }
-        reference operator*() const { return (*container)[index]; }
-        pointer operator->() const { return &**this; }
-        reference operator[](difference_type index) const { return *(*this + index); }
-    private:
-        const transient_vector<T, log_num_branches> *container;
-        size_type index;
-    };
-
+    using const_iterator = detail::chunked_iterator<transient_vector, T, log_num_branches>;
     using iterator = const_iterator;
 
     transient_vector() = default;
@@ -409,10 +1115,19 @@ public:
 
     transient_vector(const std::initializer_list<T>& elems) : transient_vector(std::begin(elems), std::end(elems)) { }
 
+    explicit transient_vector(const persistent_vector<T, log_num_branches>& v)
+        : root(v.root), tail(v.tail), count(v.count), shift(v.shift) { }
+
     transient_vector& operator=(const transient_vector& ) = delete;
     transient_vector& operator=(transient_vector&& ) = default;
 
-    persistent_vector<T, log_num_branches> persistent() &&;
+    persistent_vector<T, log_num_branches> persistent() &&
+    {
+        persistent_vector<T, log_num_branches> v{std::move(root), std::move(tail), count, shift};
+        count = 0;
+        shift = 0;
+        return v;
+    }
 
     size_type size() const { return count; }
     bool empty() const { return size() == 0; }
@@ -425,6 +1140,9 @@ public:
 
     const_reference operator[](size_type index) const
     {
+        auto offset = tail_offset();
+        if (index >= offset)
+            return base::as_leaf(tail).get(index - offset);
         return base::get(root, index, shift);
     }
 
@@ -441,6 +1159,23 @@ public:
     const_iterator begin() const { return {*this, 0}; }
     const_iterator end() const { return {*this, count}; }
 
+    friend bool operator==(const transient_vector& left, const transient_vector& right)
+    {
+        return base::equal(left, right);
+    }
+
+    template <typename F>
+    void for_each_chunk(F f) const
+    {
+        if (root)
+            base::for_each_chunk(root, shift, f);
+        if (tail)
+        {
+            auto& tail_leaf = base::as_leaf(tail);
+            f(tail_leaf.data(), tail_leaf.data() + tail_leaf.size());
+        }
+    }
+
     transient_vector insert(const_iterator pos, const T& value) const;
     template <typename InputIterator>
     transient_vector insert(const_iterator pos, InputIterator first, InputIterator last) const;
@@ -450,23 +1185,72 @@ public:
 
     void push_back(const T& elem)
     {
-        if (count == (num_branches << shift))
+        if (tail && base::as_leaf(tail).size() < num_branches)
         {
-            *this = transient_vector{ptr<node>::make(root, base::create_element(elem, shift)), count + 1, shift + log_num_branches};
+            base::editable_leaf(tail, edit).push_back(elem);
+            ++count;
             return;
         }
 
-        *this = transient_vector{base::push_back_leaf(root, elem, count, shift), count + 1, shift};
+        if (tail)
+        {
+            auto offset = tail_offset();
+            if (!root)
+                root = std::move(tail);
+            else if (!base::is_dense(root, offset))
+                root = base::push_leaf(root, shift, tail);
+            else if (offset == (num_branches << shift))
+            {
+                auto new_root = ptr<node>::make(std::move(root), base::new_editable_path(std::move(tail), shift, edit));
+                (*new_root).edit = edit;
+                root = std::move(new_root);
+                shift += log_num_branches;
+            }
+            else
+                base::push_tail_in_place(root, std::move(tail), offset, shift, edit);
+        }
+        auto new_tail = ptr<leaf>::make(elem);
+        (*new_tail).edit = edit;
+        tail = std::move(new_tail);
+        ++count;
     }
 
     void pop_back()
     {
-        if (count == (num_branches << shift) + 1)
+        if (count == 0)
+            throw std::out_of_range("transient_vector: pop_back on an empty vector");
+        if (base::as_leaf(tail).size() > 1)
         {
-            *this = transient_vector{base::as_node(root).elems[0], count - 1, shift - log_num_branches};
+            base::editable_leaf(tail, edit).pop_back();
+            --count;
             return;
         }
-        *this = transient_vector{base::pop_back_leaf(root, count - 1, shift), count - 1, shift};
+        if (count == 1)
+        {
+            *this = transient_vector{};
+            return;
+        }
+
+        if (!base::is_dense(root, tail_offset()))
+        {
+            root = base::pop_leaf(root, shift, tail);
+            base::collapse(root, shift);
+            --count;
+            return;
+        }
+        tail = base::leaf_at(root, count - 2, shift);
+        if (shift == 0)
+            root = nullptr;
+        else
+        {
+            base::pop_tail_in_place(root, count - 2, shift, edit);
+            if (!base::as_node(root).elems[1])
+            {
+                root = base::as_node(root).elems[0];
+                shift -= log_num_branches;
+            }
+        }
+        --count;
     }
 
 private:
@@ -480,18 +1264,35 @@ private:
     template <typename U>
     using ptr = typename base::template ptr<U>;
 
-    ptr<element> root;
+    ptr<element> root, tail;
     size_type count = 0;
     size_type shift = 0;
+    detail::edit_token edit = detail::new_edit_token();
 
-    transient_vector(ptr<element> root, size_type count, size_type shift) : root(std::move(root)), count(count), shift(shift) { }
-};
+    friend class detail::chunked_iterator<transient_vector, T, log_num_branches>;
+    friend class detail::persistent_vector_common<T, log_num_branches>;
 
-template <typename T, unsigned short log_num_branches>
-inline bool operator==(const transient_vector<T, log_num_branches>& left, const transient_vector<T, log_num_branches>& right)
-{
-    return left.size() == right.size() && std::equal(left.begin(), left.end(), right.begin());
-}
+    const value_type *chunk_for(size_type index, size_type& first, size_type& last) const
+    {
+        auto offset = tail_offset();
+        if (index >= offset)
+        {
+            first = offset;
+            last = count;
+            return base::as_leaf(tail).data();
+        }
+        auto local = index;
+        auto& l = base::leaf_for(root, local, shift);
+        first = index - local;
+        last = first + l.size();
+        return l.data();
+    }
+
+    size_type tail_offset() const
+    {
+        return tail ? count - base::as_leaf(tail).size() : 0;
+    }
+};
 
 template <typename T, unsigned short log_num_branches>
 inline bool operator!=(const transient_vector<T, log_num_branches>& left, const transient_vector<T, log_num_branches>& right)
@@ -0,0 +1,223 @@
+#pragma once
+#include <cstddef>
+#include <mutex>
+#include <new>
+#include <utility>
+
+namespace cimm
+{
+
+namespace detail
+{
+
+template <std::size_t block_size>
+class fixed_size_pool
+{
+public:
+    static void *allocate()
+    {
+        auto& l = local();
+        if (!l.free)
+        {
+            reap_on_exit();
+            l.free = refill();
+        }
+        auto b = l.free;
+        l.free = b->next;
+        --l.count;
+        return b;
+    }
+
+    static void deallocate(void *p) noexcept
+    {
+        auto& l = local();
+        auto b = static_cast<block *>(p);
+        b->next = l.free;
+        l.free = b;
+        if (++l.count == max_local_blocks)
+            release_batch(l);
+    }
+
+private:
+    union block
+    {
+        block *next;
+        alignas(std::max_align_t) unsigned char storage[block_size];
+    };
+
+    static const std::size_t chunk_size = 64 * 1024;
+    static const std::size_t min_blocks_per_chunk = 16;
+    static const std::size_t blocks_per_chunk =
+        (chunk_size - sizeof(void *)) / sizeof(block) > min_blocks_per_chunk ?
+        (chunk_size - sizeof(void *)) / sizeof(block) : min_blocks_per_chunk;
+
+    // Blocks freed by a thread that does not allocate them (a consumer) go back to the other threads in batches
+    static const std::size_t max_local_blocks = 2 * blocks_per_chunk;
+
+    struct chunk
+    {
+        chunk *next;
+        block blocks[blocks_per_chunk];
+    };
+
+    // The first block of a batch also links the next batch
+    struct batch
+    {
+        block *next;
+        batch *next_batch;
+    };
+
+    static_assert(sizeof(batch) <= sizeof(block), "a block must be able to hold a batch link");
+
+    // Chunks are never released: a block may outlive the thread that allocated it
+    struct shared_state
+    {
+        std::mutex mutex;
+        chunk *chunks = nullptr;
+        batch *orphaned = nullptr;
+    };
+
+    // Kept trivially destructible so blocks released during static destruction are still accepted
+    struct local_state
+    {
+        block *free;
+        std::size_t count;
+    };
+
+    struct local_reaper
+    {
+        ~local_reaper()
+        {
+            auto& l = local();
+            if (!l.free)
+                return;
+            push_batch(l.free);
+            l.free = nullptr;
+            l.count = 0;
+        }
+    };
+
+    static shared_state& shared()
+    {
+        static auto s = new shared_state;
+        return *s;
+    }
+
+    static local_state& local()
+    {
+        static thread_local local_state l{nullptr, 0};
+        return l;
+    }
+
+    static void push_batch(block *first)
+    {
+        auto b = reinterpret_cast<batch *>(first);
+        auto& s = shared();
+        std::lock_guard<std::mutex> lock(s.mutex);
+        b->next_batch = s.orphaned;
+        s.orphaned = b;
+    }
+
+    static block *take_batch()
+    {
+        auto& s = shared();
+        std::lock_guard<std::mutex> lock(s.mutex);
+        auto b = s.orphaned;
+        if (b)
+            s.orphaned = b->next_batch;
+        return reinterpret_cast<block *>(b);
+    }
+
+    static void reap_on_exit()
+    {
+        static thread_local local_reaper reaper;
+        (void)reaper;
+    }
+
+    // Keeps the most recently freed half and hands the older half over
+    static void release_batch(local_state& l) noexcept
+    {
+        reap_on_exit();
+        auto last = l.free;
+        for (std::size_t i = 1; i < max_local_blocks - blocks_per_chunk; ++i)
+            last = last->next;
+        auto first = last->next;
+        last->next = nullptr;
+        l.count -= blocks_per_chunk;
+        push_batch(first);
+    }
+
+    static block *refill()
+    {
+        auto& l = local();
+        if (auto free = take_batch())
+        {
+            l.count = 0;
+            for (auto b = free; b; b = b->next)
+                ++l.count;
+            return free;
+        }
+        auto& s = shared();
+        std::lock_guard<std::mutex> lock(s.mutex);
+        auto c = static_cast<chunk *>(::operator new(sizeof(chunk)));
+        c->next = s.chunks;
+        s.chunks = c;
+        for (std::size_t i = 0; i + 1 < blocks_per_chunk; ++i)
+            c->blocks[i].next = &c->blocks[i + 1];
+        c->blocks[blocks_per_chunk - 1].next = nullptr;
+        l.count = blocks_per_chunk;
+        return c->blocks;
+    }
+};
+
+constexpr std::size_t pool_size_class(std::size_t size)
+{
+    return (size + alignof(std::max_align_t) - 1) / alignof(std::max_align_t) * alignof(std::max_align_t);
+}
+
+template <typename T>
+using pool_for = fixed_size_pool<pool_size_class(sizeof(T))>;
+
+// Blocks of run-time sizes up to this many bytes come from the pool of their size class, larger ones from operator new
+const std::size_t max_pooled_size = 1024;
+
+template <typename Indices>
+struct size_class_pools;
+
+template <std::size_t... I>
+struct size_class_pools<std::index_sequence<I...>>
+{
+    static void *allocate(std::size_t size_class)
+    {
+        static void *(*const allocate[])() = {&fixed_size_pool<(I + 1) * alignof(std::max_align_t)>::allocate...};
+        return allocate[size_class]();
+    }
+
+    static void deallocate(std::size_t size_class, void *p) noexcept
+    {
+        static void (*const deallocate[])(void *) = {&fixed_size_pool<(I + 1) * alignof(std::max_align_t)>::deallocate...};
+        deallocate[size_class](p);
+    }
+};
+
+using pooled_sizes = size_class_pools<std::make_index_sequence<max_pooled_size / alignof(std::max_align_t)>>;
+
+inline void *allocate_bytes(std::size_t size)
+{
+    if (size > max_pooled_size)
+        return ::operator new(size);
+    return pooled_sizes::allocate((size - 1) / alignof(std::max_align_t));
+}
+
+// size must be the one passed to allocate_bytes
+inline void deallocate_bytes(void *p, std::size_t size) noexcept
+{
+    if (size > max_pooled_size)
+        ::operator delete(p);
+    else
+        pooled_sizes::deallocate((size - 1) / alignof(std::max_align_t), p);
+}
+
+}
+
+}
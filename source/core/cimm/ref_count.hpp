@@ -0,0 +1,201 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#if defined(__has_include)
+#if __has_include(<sys/single_threaded.h>)
+#include <sys/single_threaded.h>
+#define CIMM_HAS_LIBC_SINGLE_THREADED
+#endif
+#endif
+
+namespace cimm
+{
+
+namespace detail
+{
+
+class unsynchronized_count
+{
+public:
+    unsynchronized_count(std::uint32_t value) : value(value) { }
+    unsynchronized_count(const unsynchronized_count& ) = delete;
+    unsynchronized_count& operator=(const unsynchronized_count& ) = delete;
+
+    std::uint32_t operator++() { return ++value; }
+    std::uint32_t operator--() { return --value; }
+
+    std::uint32_t fetch_add(std::uint32_t n, std::memory_order = std::memory_order_seq_cst)
+    {
+        auto prev = value;
+        value += n;
+        return prev;
+    }
+
+    std::uint32_t fetch_sub(std::uint32_t n, std::memory_order = std::memory_order_seq_cst)
+    {
+        auto prev = value;
+        value -= n;
+        return prev;
+    }
+
+    std::uint32_t load(std::memory_order = std::memory_order_seq_cst) const { return value; }
+
+private:
+    std::uint32_t value;
+};
+
+#ifdef CIMM_HAS_LIBC_SINGLE_THREADED
+
+// Like libstdc++'s shared_ptr, skips locked instructions until the process starts its first thread
+class dispatched_count
+{
+public:
+    dispatched_count(std::uint32_t value) : value(value) { }
+    dispatched_count(const dispatched_count& ) = delete;
+    dispatched_count& operator=(const dispatched_count& ) = delete;
+
+    std::uint32_t operator++() { return fetch_add(1) + 1; }
+    std::uint32_t operator--() { return fetch_sub(1) - 1; }
+
+    std::uint32_t fetch_add(std::uint32_t n, std::memory_order order = std::memory_order_seq_cst)
+    {
+        if (!__libc_single_threaded)
+            return value.fetch_add(n, order);
+        auto prev = value.load(std::memory_order_relaxed);
+        value.store(prev + n, std::memory_order_relaxed);
+        return prev;
+    }
+
+    std::uint32_t fetch_sub(std::uint32_t n, std::memory_order order = std::memory_order_seq_cst)
+    {
+        if (!__libc_single_threaded)
+            return value.fetch_sub(n, order);
+        auto prev = value.load(std::memory_order_relaxed);
+        value.store(prev - n, std::memory_order_relaxed);
+        return prev;
+    }
+
+    std::uint32_t load(std::memory_order order = std::memory_order_seq_cst) const { return value.load(order); }
+
+private:
+    std::atomic<std::uint32_t> value;
+};
+
+#endif
+
+#if defined(CIMM_SINGLE_THREADED)
+using reference_count = unsynchronized_count;
+#elif defined(CIMM_HAS_LIBC_SINGLE_THREADED)
+using reference_count = dispatched_count;
+#else
+using reference_count = std::atomic<std::uint32_t>;
+#endif
+
+#ifdef CIMM_SINGLE_THREADED
+
+// Owner of a shared object and its count; the object lives in the same allocation
+class shared_block
+{
+public:
+    shared_block() = default;
+    shared_block(const shared_block& ) = delete;
+    shared_block& operator=(const shared_block& ) = delete;
+    virtual ~shared_block() = default;
+
+    unsynchronized_count count{1};
+};
+
+template <typename T>
+class shared_block_of : public shared_block
+{
+public:
+    template <typename... Args>
+    shared_block_of(Args&&... args) : value(std::forward<Args>(args)...) { }
+
+    T value;
+};
+
+// The subset of std::shared_ptr used for scopes, closures and native callables, with a non-atomic count
+template <typename T>
+class shared_ptr
+{
+public:
+    shared_ptr() = default;
+    shared_ptr(std::nullptr_t) { }
+    shared_ptr(const shared_ptr& other) : ptr(other.ptr), block(other.block) { retain(); }
+    shared_ptr(shared_ptr&& other) noexcept : ptr(other.ptr), block(other.block) { other.ptr = nullptr; other.block = nullptr; }
+
+    template <typename U, typename = std::enable_if_t<std::is_convertible<U *, T *>::value>>
+    shared_ptr(const shared_ptr<U>& other) : ptr(other.ptr), block(other.block) { retain(); }
+
+    template <typename U, typename = std::enable_if_t<std::is_convertible<U *, T *>::value>>
+    shared_ptr(shared_ptr<U>&& other) noexcept : ptr(other.ptr), block(other.block) { other.ptr = nullptr; other.block = nullptr; }
+
+    ~shared_ptr() { release(); }
+
+    shared_ptr& operator=(shared_ptr other) noexcept
+    {
+        std::swap(ptr, other.ptr);
+        std::swap(block, other.block);
+        return *this;
+    }
+
+    T *get() const { return ptr; }
+    T& operator*() const { return *ptr; }
+    T *operator->() const { return ptr; }
+    explicit operator bool() const { return ptr != nullptr; }
+
+    friend bool operator==(const shared_ptr& left, const shared_ptr& right) { return left.ptr == right.ptr; }
+    friend bool operator!=(const shared_ptr& left, const shared_ptr& right) { return left.ptr != right.ptr; }
+
+private:
+    template <typename U>
+    friend class shared_ptr;
+    template <typename U, typename... Args>
+    friend auto make_shared(Args&&... args) -> shared_ptr<U>;
+
+    T *ptr = nullptr;
+    shared_block *block = nullptr;
+
+    shared_ptr(T *ptr, shared_block *block) : ptr(ptr), block(block) { }
+
+    void retain() const
+    {
+        if (block)
+            ++block->count;
+    }
+
+    void release()
+    {
+        if (block && --block->count == 0)
+            delete block;
+    }
+};
+
+template <typename T, typename... Args>
+inline auto make_shared(Args&&... args) -> shared_ptr<T>
+{
+    auto block = new shared_block_of<T>(std::forward<Args>(args)...);
+    return {&block->value, block};
+}
+
+#else
+
+// libstdc++'s shared_ptr already skips locked instructions while the process has one thread
+template <typename T>
+using shared_ptr = std::shared_ptr<T>;
+
+template <typename T, typename... Args>
+inline auto make_shared(Args&&... args)
+{
+    return std::make_shared<T>(std::forward<Args>(args)...);
+}
+
+#endif
+
+}
+
+}
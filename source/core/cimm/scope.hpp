@@ -0,0 +1,47 @@
+#pragma once
+#include "expression.hpp"
+#include "vector.hpp"
+#include <boost/optional.hpp>
+#include <boost/container/small_vector.hpp>
+#include "ref_count.hpp"
+
+namespace cimm
+{
+
+// A frame of locals: values[i] is bound to names[i * stride], so parameter vectors
+// (stride 1) and let/loop binding vectors (stride 2) are used without copying
+struct scope
+{
+    using values_type = boost::container::small_vector<expression, 4>;
+
+    vector names;
+    std::size_t stride;
+    values_type values;
+    detail::shared_ptr<const scope> parent;
+};
+
+using scope_ptr = detail::shared_ptr<const scope>;
+
+inline auto make_scope(vector names, std::size_t stride, scope::values_type values, scope_ptr parent) -> scope_ptr
+{
+    return detail::make_shared<scope>(scope{std::move(names), stride, std::move(values), std::move(parent)});
+}
+
+// The last binding of a name in a scope wins, as in (let [x 1 x 2] x)
+inline auto find_local(const scope *s, const symbol& name) -> boost::optional<expression>
+{
+    for (; s; s = s->parent.get())
+    {
+        auto index = s->values.size();
+        for (auto it = begin(s->names) + index * s->stride; index != 0;)
+        {
+            --index;
+            it -= s->stride;
+            if (*it == name)
+                return s->values[index];
+        }
+    }
+    return boost::none;
+}
+
+}
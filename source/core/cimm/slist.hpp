@@ -1,5 +1,8 @@
 #pragma once
 #include "expression.hpp"
+#include "pool.hpp"
+#include "ref_count.hpp"
+#include <cstdint>
 
 namespace cimm
 {
@@ -8,12 +11,22 @@ class slist
 {
 public:
     slist() = default;
-    slist(expression e) : node_(std::make_shared<node>(std::move(e))), count_(1) { }
-    slist(expression e, slist next) : node_(std::make_shared<node>(std::move(e), std::move(next.node_))), count_(next.count() + 1) { }
-    integer count() const { return count_; }
+    slist(expression e) : node_(node::make(std::move(e), nullptr)) { }
+    slist(expression e, slist next) : node_(node::make(std::move(e), next.detach())) { }
+    slist(const slist& other) noexcept : node_(retain(other.node_)) { }
+    slist(slist&& other) noexcept : node_(other.detach()) { }
+    ~slist() { release(node_); }
+
+    slist& operator=(slist other) noexcept
+    {
+        std::swap(node_, other.node_);
+        return *this;
+    }
+
+    integer count() const { return node_ ? node_->count : 0; }
     expression first() const { return node_ ? node_->value : nil; }
     auto cons(expression e) const { return slist{std::move(e), *this}; }
-    auto next() const { return node_ ? slist{node_->next, count_ - 1} : slist{}; }
+    auto next() const { return node_ ? slist{retain(node_->next)} : slist{}; }
 
     template <typename F>
     auto map(F&& f) const
@@ -21,41 +34,79 @@ public:
         if (count() == 0)
             return *this;
 
-        auto dnode = std::make_shared<node>(f(node_->value));
-        slist d{dnode, count()};
+        slist d{node::make(f(node_->value), nullptr, node_->count)};
 
+        auto dnode = d.node_;
         for (auto snode = node_->next; snode; snode = snode->next, dnode = dnode->next)
-            dnode->next = std::make_shared<node>(f(snode->value));;
+            dnode->next = node::make(f(snode->value), nullptr, snode->count);
 
         return d;
     }
 
     friend auto operator==(const slist& left, const slist& right)
     {
-        return left.count() == right.count() && (!left.node_ || *left.node_ == *right.node_);
+        if (left.count() != right.count())
+            return false;
+        for (auto l = left.node_, r = right.node_; l != r; l = l->next, r = r->next)
+            if (!(l->value == r->value))
+                return false;
+        return true;
     }
 
 private:
 
+    // value, link and length share one pooled 32-byte block; lists are limited to 2^32 - 1 elements
     struct node
     {
+        mutable detail::reference_count ref_count{1};
+        std::uint32_t count;
         const expression value;
-        std::shared_ptr<node> next;
+        node *next;
+
+        node(expression value, node *next, std::uint32_t count)
+            : count(count), value(std::move(value)), next(next) { }
 
-        node(expression value, std::shared_ptr<node> next = nullptr)
-            : value(std::move(value)), next(std::move(next)) { }
+        static node *make(expression value, node *next)
+        {
+            return make(std::move(value), next, next ? next->count + 1 : 1);
+        }
 
-        auto operator==(const node& other) const -> bool
+        static node *make(expression value, node *next, std::uint32_t count)
         {
-            return value == other.value && (!next || *next == *other.next);
+            return new (node_pool::allocate()) node{std::move(value), next, count};
         }
     };
 
-    std::shared_ptr<node> node_;
-    integer count_ = 0;
+    using node_pool = detail::pool_for<node>;
+
+    node *node_ = nullptr;
 
-    slist(std::shared_ptr<node> node_, integer count_) : node_(node_), count_(count_) { }
-    slist(expression e, std::shared_ptr<node> node_) : node_(std::make_shared<node>(e, node_)) { }
+    explicit slist(node *n) : node_(n) { }
+
+    node *detach() noexcept
+    {
+        auto n = node_;
+        node_ = nullptr;
+        return n;
+    }
+
+    static node *retain(node *n) noexcept
+    {
+        if (n)
+            n->ref_count.fetch_add(1, std::memory_order_relaxed);
+        return n;
+    }
+
+    static void release(node *n) noexcept
+    {
+        while (n && n->ref_count.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        {
+            auto next = n->next;
+            n->~node();
+            node_pool::deallocate(n);
+            n = next;
+        }
+    }
 };
 
 }
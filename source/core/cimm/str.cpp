@@ -1,58 +1,162 @@
 #include "str.hpp"
 #include "expression.hpp"
-#include <sstream>
 
 namespace cimm
 {
 
-auto pr_str(vector const& v) -> string
+namespace
+{
+
+struct print_visitor : expression::visitor<void>
 {
-    std::ostringstream os;
-    os << '[';
-    for (auto e = begin(v); e != end(v); ++e)
+    string_builder& out;
+    print_visitor(string_builder& out) : out(out) { }
+
+    void operator()(const string& s) const { pr_str(out, s); }
+
+    void operator()(const integer& i) const
     {
-        if (e != begin(v))
-          os << ' ';
-        os << pr_str(*e);
+        char digits[16];
+        auto last = digits + sizeof(digits);
+        auto first = last;
+        auto n = i < 0 ? -static_cast<long long>(i) : static_cast<long long>(i);
+        do
+            *--first = char('0' + n % 10);
+        while (n /= 10);
+        if (i < 0)
+            *--first = '-';
+        out.append(first, last - first);
     }
-    os << ']';
-    return os.str();
-}
 
-auto pr_str(list const& l) -> string
-{
-    std::ostringstream os;
-    os << '(';
-    for (auto e = l; not is_empty(e); e = rest(e))
+    void operator()(const keyword& k) const
+    {
+        out.append(':');
+        out.append(name(k));
+    }
+
+    void operator()(const list& l) const
+    {
+        out.append('(');
+        for (auto e = l; not is_empty(e); e = rest(e))
+        {
+            if (count(e) != count(l))
+                out.append(' ');
+            pr_str(out, first(e));
+        }
+        out.append(')');
+    }
+
+    void operator()(const vector& v) const
     {
-        if (count(e) != count(l))
-          os << ' ';
-        os << pr_str(first(e));
+        out.append('[');
+        auto separator = "";
+        for_each(v, [&](auto& e)
+        {
+            out.append(separator);
+            pr_str(out, e);
+            separator = " ";
+        });
+        out.append(']');
     }
-    os << ')';
-    return os.str();
+
+    void operator()(const hash_map& m) const
+    {
+        out.append('{');
+        auto separator = "";
+        for_each(m, [&](auto& k, auto& v)
+        {
+            out.append(separator);
+            pr_str(out, k);
+            out.append(' ');
+            pr_str(out, v);
+            separator = ", ";
+        });
+        out.append('}');
+    }
+
+    void operator()(const hash_set& s) const
+    {
+        out.append("#{");
+        auto separator = "";
+        for_each(s, [&](auto& e)
+        {
+            out.append(separator);
+            pr_str(out, e);
+            separator = " ";
+        });
+        out.append('}');
+    }
+
+    void operator()(const error& e) const
+    {
+        out.append("error: ");
+        pr_str(out, unwrap(e));
+    }
+
+    template <typename expression_type>
+    void operator()(const expression_type& e) const { out.append(pr_str(e)); }
+};
+
+struct to_string : print_visitor
+{
+    using print_visitor::print_visitor;
+    using print_visitor::operator();
+
+    void operator()(const string& s) const { out.append(s); }
+};
+
+template <typename expression_type>
+auto print(const expression_type& e) -> string
+{
+    string_builder out;
+    print_visitor{out}(e);
+    return out.str();
 }
 
-namespace
+}
+
+auto pr_str(vector const& v) -> string
 {
+    return print(v);
+}
 
-struct to_string : expression::visitor<string>
+auto pr_str(hash_map const& m) -> string
 {
-    template <typename expression_type>
-    string operator()(const expression_type& e) const { return pr_str(e); }
-    string operator()(const string& s) const { return s; }
-};
+    return print(m);
+}
 
+auto pr_str(hash_set const& s) -> string
+{
+    return print(s);
+}
+
+auto pr_str(list const& l) -> string
+{
+    return print(l);
+}
+
+auto pr_str(string_builder& out, const expression& e) -> void
+{
+    apply(print_visitor{out}, e);
+}
+
+auto str(string_builder& out, const expression& e) -> void
+{
+    apply(to_string{out}, e);
 }
 
 auto str(const expression& e) -> string
 {
-    return apply(to_string(), e);
+    string_builder out;
+    str(out, e);
+    return out.str();
 }
 
 auto pr_str(const expression& e) -> string
 {
-    return apply([](auto& e) { return pr_str(e); }, e);
+    string_builder out;
+    pr_str(out, e);
+    return out.str();
 }
 
 }
@@ -6,11 +6,17 @@ namespace cimm
 
 class expression;
 class vector;
+class hash_map;
+class hash_set;
 class list;
 
 auto str(const expression& e) -> string;
+auto str(string_builder& out, const expression& e) -> void;
+auto pr_str(string_builder& out, const expression& e) -> void;
 auto pr_str(const expression& e) -> string;
 auto pr_str(vector const& v) -> string;
+auto pr_str(hash_map const& m) -> string;
+auto pr_str(hash_set const& s) -> string;
 auto pr_str(list const& l) -> string;
 
 }
@@ -1,4 +1,5 @@
 #include "string.hpp"
+#include <algorithm>
 #include <array>
 #include <utility>
 
@@ -10,23 +11,30 @@ namespace
 
 std::array<std::pair<char, const char *>, 3> escaped = { { { '\n', "\\n" }, { '\"', "\\\"" }, { '\\', "\\\\" } } };
 
-void append_char(char c, std::string& printed)
+auto append_char(char c, string_builder& out) -> void
 {
     auto found = std::find_if(begin(escaped), end(escaped), [c](auto& e) { return e.first == c; });
     if (found != end(escaped))
-        printed += found->second;
+        out.append(found->second);
     else
-        printed += c;
+        out.append(c);
 }
 
 }
 
-auto pr_str(const string& s) -> string
+auto pr_str(string_builder& out, const string& s) -> void
 {
-    std::string printed = "\"";
+    out.append('\"');
     for (auto c : s)
-        append_char(c, printed);
-    return printed += "\"";
+        append_char(c, out);
+    out.append('\"');
+}
+
+auto pr_str(const string& s) -> string
+{
+    string_builder out;
+    pr_str(out, s);
+    return out.str();
 }
 
 }
@@ -1,35 +1,195 @@
 #pragma once
+#include "ref_count.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
 #include <string>
 #include <ostream>
 
 namespace cimm
 {
 
+namespace detail
+{
+
+// MurmurHash64A, the function behind libstdc++'s std::hash<std::string>
+inline auto hash_bytes(const char *data, std::size_t size) -> std::size_t
+{
+    const std::uint64_t m = 0xc6a4a7935bd1e995ull;
+    const int r = 47;
+    std::uint64_t h = 0xc70f6907ull ^ (size * m);
+    auto end = data + (size & ~std::size_t(7));
+    for (; data != end; data += 8)
+    {
+        std::uint64_t k;
+        std::memcpy(&k, data, sizeof(k));
+        k *= m;
+        k ^= k >> r;
+        k *= m;
+        h ^= k;
+        h *= m;
+    }
+    if (size & 7)
+    {
+        std::uint64_t k = 0;
+        std::memcpy(&k, data, size & 7);
+        h ^= k;
+        h *= m;
+    }
+    h ^= h >> r;
+    h *= m;
+    h ^= h >> r;
+    return static_cast<std::size_t>(h);
+}
+
+}
+
+// Immutable; up to 15 characters are stored inline, longer text is shared between copies. The hash is computed once.
 class string
 {
 public:
-    using const_iterator = std::string::const_iterator;
+    using const_iterator = const char *;
+
+    string() noexcept : size_(0), hash_(empty_hash()) { small[0] = '\0'; }
+    string(const std::string& s) : string(s.data(), s.size()) { }
+    string(const char *s) : string(s, std::strlen(s)) { }
+
+    string(const char *s, std::size_t size) : size_(size)
+    {
+        auto dest = allocate();
+        std::memcpy(dest, s, size);
+        dest[size] = '\0';
+        hash_ = detail::hash_bytes(dest, size);
+    }
+
+    string(const string& other) noexcept : size_(other.size_), hash_(other.hash_)
+    {
+        if (is_small())
+            std::memcpy(small, other.small, sizeof(small));
+        else
+        {
+            heap = other.heap;
+            heap->ref_count.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    string(string&& other) noexcept : size_(other.size_), hash_(other.hash_)
+    {
+        std::memcpy(small, other.small, sizeof(small));
+        other.size_ = 0;
+        other.hash_ = empty_hash();
+        other.small[0] = '\0';
+    }
+
+    auto operator=(string other) noexcept -> string&
+    {
+        swap(*this, other);
+        return *this;
+    }
+
+    ~string()
+    {
+        if (!is_small() && heap->ref_count.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        {
+            heap->~rep();
+            ::operator delete(heap);
+        }
+    }
+
+    friend auto swap(string& left, string& right) noexcept -> void
+    {
+        char tmp[sizeof(small)];
+        std::memcpy(tmp, left.small, sizeof(small));
+        std::memcpy(left.small, right.small, sizeof(small));
+        std::memcpy(right.small, tmp, sizeof(small));
+        std::swap(left.size_, right.size_);
+        std::swap(left.hash_, right.hash_);
+    }
+
+    auto c_str() const -> const char * { return data(); }
+    auto size() const -> std::size_t { return size_; }
+    auto std_hash() const -> std::size_t { return hash_; }
+
+    friend const_iterator begin(const string& s) { return s.data(); }
+    friend const_iterator end(const string& s) { return s.data() + s.size_; }
 
-    string() {}
-    string(std::string s) : value(std::move(s)) { }
-    string(const char *s) : value(s) { }
+    friend auto operator==(const string& left, const string& right)
+    {
+        return left.size_ == right.size_ && left.hash_ == right.hash_ &&
+            (left.data() == right.data() || std::memcmp(left.data(), right.data(), left.size_) == 0);
+    }
 
-    auto c_str() const { return value.c_str(); }
-    auto std_hash() const { return std::hash<std::string>()(value); }
+    friend auto operator!=(const string& left, const string& right) { return !(left == right); }
+
+    friend string operator+(char left, const string& right) { return concat(&left, 1, right.data(), right.size_); }
+    friend string operator+(const string& left, char right) { return concat(left.data(), left.size_, &right, 1); }
+    friend string operator+(const string& left, const string& right) { return concat(left.data(), left.size_, right.data(), right.size_); }
+    friend auto& operator<<(std::ostream& os, const string& s) { return os.write(s.data(), s.size_); }
+
+private:
+    static const std::size_t inline_capacity = 15;
+
+    struct rep
+    {
+        mutable detail::reference_count ref_count{1};
+        char text[1];
+    };
+
+    union
+    {
+        char small[inline_capacity + 1];
+        rep *heap;
+    };
+    std::size_t size_;
+    std::size_t hash_;
+
+    struct uninitialized { };
+
+    string(std::size_t size, uninitialized) : size_(size), hash_(0) { }
+
+    static auto empty_hash() -> std::size_t { return detail::hash_bytes(nullptr, 0); }
+
+    auto is_small() const -> bool { return size_ <= inline_capacity; }
+    auto data() const -> const char * { return is_small() ? small : heap->text; }
+
+    auto allocate() -> char *
+    {
+        if (is_small())
+            return small;
+        heap = new (::operator new(sizeof(rep) + size_)) rep;
+        return heap->text;
+    }
+
+    static auto concat(const char *left, std::size_t left_size, const char *right, std::size_t right_size) -> string
+    {
+        string s(left_size + right_size, uninitialized{});
+        auto dest = s.allocate();
+        std::memcpy(dest, left, left_size);
+        std::memcpy(dest + left_size, right, right_size);
+        dest[s.size_] = '\0';
+        s.hash_ = detail::hash_bytes(dest, s.size_);
+        return s;
+    }
+};
+
+// Accumulates text in one buffer so that printing nested values stays linear
+class string_builder
+{
+public:
+    auto append(const char *s, std::size_t size) -> string_builder& { buffer.append(s, size); return *this; }
+    auto append(const char *s) -> string_builder& { buffer.append(s); return *this; }
+    auto append(const string& s) -> string_builder& { return append(s.c_str(), s.size()); }
+    auto append(char c) -> string_builder& { buffer.push_back(c); return *this; }
 
-    friend const_iterator begin(const string& s) { return std::begin(s.value); }
-    friend const_iterator end(const string& s) { return std::end(s.value); }
+    auto str() const -> string { return string(buffer.data(), buffer.size()); }
 
-    friend auto operator==(const string& left, const string& right) { return left.value == right.value; }
-    friend string operator+(char left, const string& right) { return left + right.value; }
-    friend string operator+(const string& left, char right) { return left.value + right; }
-    friend string operator+(const string& left, const string& right) { return left.value + right.value; }
-    friend auto& operator<<(std::ostream& os, const string& s) { return os << s.value; }
 private:
-    std::string value;
+    std::string buffer;
 };
 
 auto pr_str(const string& s) -> string;
+auto pr_str(string_builder& out, const string& s) -> void;
 
 }
 
@@ -7,36 +7,91 @@ namespace cimm
 
 auto as_list(const expression& e) -> list const&
 {
-    return boost::get<list>(e.value);
+    if (e.tag_ == expression::tag::list)
+        return e.unboxed<list>();
+    throw type_error(e, "a list");
 }
 
 auto as_vector(const expression& e) -> vector const&
 {
-    if (auto val = boost::get<vector>(&e.value))
-        return *val;
+    if (e.tag_ == expression::tag::vector)
+        return e.unboxed<vector>();
     throw type_error(e, "a vector");
 }
 
+auto as_hash_map(const expression& e) -> hash_map const&
+{
+    if (e.tag_ == expression::tag::hash_map)
+        return e.unboxed<hash_map>();
+    throw type_error(e, "a map");
+}
+
+auto as_hash_set(const expression& e) -> hash_set const&
+{
+    if (e.tag_ == expression::tag::hash_set)
+        return e.unboxed<hash_set>();
+    throw type_error(e, "a set");
+}
+
+auto as_function(const expression& e) -> function const&
+{
+    if (e.tag_ == expression::tag::function)
+        return e.unboxed<function>();
+    throw type_error(e, "a function");
+}
+
+auto as_closure(const expression& e) -> closure const&
+{
+    if (e.tag_ == expression::tag::closure)
+        return e.unboxed<closure>();
+    throw type_error(e, "a closure");
+}
+
+auto as_native_function(const expression& e) -> native_function const&
+{
+    if (e.tag_ == expression::tag::native_function)
+        return e.unboxed<native_function>();
+    throw type_error(e, "a native function");
+}
+
+auto as_string(const expression& e) -> string const&
+{
+    if (e.tag_ == expression::tag::string)
+        return e.unboxed<string>();
+    throw type_error(e, "a string");
+}
+
+auto as_boolean(const expression& e) -> boolean
+{
+    if (e.tag_ == expression::tag::boolean)
+        return e.payload.b;
+    throw type_error(e, "a boolean");
+}
+
 auto as_symbol(const expression& e) -> symbol const&
 {
-    return boost::get<symbol>(e.value);
+    if (e.tag_ == expression::tag::symbol)
+        return e.payload.name;
+    throw type_error(e, "a symbol");
 }
 
 auto as_integer(const expression& e) -> integer
 {
-    if (auto val = boost::get<integer>(&e.value))
-        return *val;
+    if (e.tag_ == expression::tag::integer)
+        return e.payload.i;
     throw type_error(e, "an integer");
 }
 
 auto is_error(const expression& e) -> bool
 {
-    return boost::get<error>(&e.value) != nullptr;
+    return e.tag_ == expression::tag::error;
 }
 
 auto as_generic_method(expression& e) -> generic_method&
 {
-    return boost::get<generic_method>(e.value);
+    if (e.tag_ == expression::tag::generic_method)
+        return e.unshared<generic_method>();
+    throw type_error(e, "a generic method");
 }
 
 }
@@ -3,6 +3,8 @@
 #include "list.hpp"
 #include "type_error.hpp"
 #include "persistent_vector.hpp"
+#include <algorithm>
+#include <iterator>
 
 namespace cimm
 {
@@ -13,8 +15,10 @@ public:
     vector() = default;
     explicit vector(list l)
     {
+        transient_vector<expression> t;
         for (; not is_empty(l); l = rest(l))
-            value = value.push_back(first(l));
+            t.push_back(first(l));
+        value = std::move(t).persistent();
     }
 
     template <typename Iterator>
@@ -24,8 +28,13 @@ public:
 
     explicit vector(const std::vector<expression>& v) : vector(begin(v), end(v)) { }
 
+    explicit vector(std::vector<expression>&& v) : vector(std::make_move_iterator(begin(v)), std::make_move_iterator(end(v))) { }
+
     vector(persistent_vector<expression> v) : value(std::move(v)) { }
 
+    // Structural hash; the part covering the tree is kept in its root node
+    auto std_hash() const -> std::size_t;
+
     friend auto begin(const vector& v)
     {
         return v.value.begin();
@@ -46,13 +55,18 @@ public:
         return left.value == right.value;
     }
 
+    template <typename F>
+    friend auto for_each(vector const& v, F&& f)
+    {
+        v.value.for_each_chunk([&](auto first, auto last) { std::for_each(first, last, f); });
+    }
+
     template <typename F>
     friend auto map(vector const& v, F&& f)
     {
-        persistent_vector<expression> r;
-        for (auto& e : v)
-          r = r.push_back(f(e));
-        return vector(r);
+        transient_vector<expression> r;
+        for_each(v, [&](auto& e) { r.push_back(f(e)); });
+        return vector(std::move(r).persistent());
     }
 
     friend auto conj(const vector& v, expression e)
@@ -60,6 +74,16 @@ public:
         return vector(v.value.push_back(e));
     }
 
+    friend auto subvec(const vector& v, integer first, integer last)
+    {
+        return vector(v.value.slice(first, last));
+    }
+
+    friend auto concat(const vector& left, const vector& right)
+    {
+        return vector(left.value.concat(right.value));
+    }
+
 private:
     persistent_vector<expression> value;
 };
@@ -76,7 +100,7 @@ inline auto first(const vector& v)
 
 inline auto rest(const vector& l)
 {
-    return is_empty(l) ? vector{} : vector(std::next(begin(l)), end(l));
+    return is_empty(l) ? vector{} : subvec(l, 1, count(l));
 }
 
 template <typename expression_type>
@@ -0,0 +1,232 @@
+#include "bytecode.hpp"
+#include "eval.hpp"
+#include "default_environment.hpp"
+#include "error.hpp"
+#include <algorithm>
+#include <iterator>
+
+#if defined(__GNUC__)
+#define CIMM_THREADED_DISPATCH
+#endif
+
+namespace cimm
+{
+
+namespace
+{
+
+auto unwrap_error(const error& e) -> expression { return unwrap(e); }
+
+template <typename expression_type>
+auto unwrap_error(const expression_type& e) -> expression { return e; }
+
+auto make_closure(const closure_template& t, const expression *r, const frame& f) -> closure
+{
+    closure c{t.code, {}};
+    c.captured.reserve(t.captures.size());
+    for (auto& capture : t.captures)
+        c.captured.push_back(capture.kind == locals::resolved::slot ? r[capture.index] : f.self->captured[capture.index]);
+    return c;
+}
+
+auto run(environment& env, const chunk& entry, frame& f) -> expression
+{
+    auto code = &entry;
+    auto r = f.slots.data();
+    auto ip = code->code.data();
+    const instruction *in;
+    expression callee;
+
+#ifdef CIMM_THREADED_DISPATCH
+    static void *const dispatch_table[] = {
+        &&op_load_constant, &&op_load_global, &&op_load_captured, &&op_move,
+        &&op_make_vector, &&op_make_hash_map, &&op_make_hash_set, &&op_make_closure, &&op_call, &&op_tail_call, &&op_jump,
+        &&op_jump_if_false, &&op_jump_if_not_error, &&op_unwrap_error, &&op_check_undefined,
+        &&op_define, &&op_define_generic, &&op_define_method, &&op_return_
+    };
+#define VM_CASE(name) op_##name
+#define VM_NEXT() do { in = ip++; goto *dispatch_table[static_cast<int>(in->op)]; } while (0)
+    VM_NEXT();
+#else
+#define VM_CASE(name) case opcode::name
+#define VM_NEXT() break
+    for (;;)
+    {
+    in = ip++;
+    switch (in->op)
+    {
+#endif
+
+    VM_CASE(load_constant):
+        r[in->a] = code->constants[in->b];
+        VM_NEXT();
+
+    VM_CASE(load_global):
+        r[in->a] = value(*code->globals[in->b]);
+        VM_NEXT();
+
+    VM_CASE(load_captured):
+        r[in->a] = f.self->captured[in->b];
+        VM_NEXT();
+
+    VM_CASE(move):
+        r[in->a] = r[in->b];
+        VM_NEXT();
+
+    VM_CASE(make_vector):
+        r[in->a] = vector(r + in->b, r + in->b + in->c);
+        VM_NEXT();
+
+    VM_CASE(make_hash_map):
+    {
+        hash_map m;
+        for (auto e = r + in->b; e != r + in->b + in->c; e += 2)
+            m = assoc(m, e[0], e[1]);
+        r[in->a] = m;
+        VM_NEXT();
+    }
+
+    VM_CASE(make_hash_set):
+    {
+        hash_set s;
+        for (auto e = r + in->b; e != r + in->b + in->c; ++e)
+            s = conj(s, *e);
+        r[in->a] = s;
+        VM_NEXT();
+    }
+
+    VM_CASE(make_closure):
+        r[in->a] = make_closure(code->functions[in->b], r, f);
+        VM_NEXT();
+
+    VM_CASE(call):
+    {
+        auto fn = r + in->b;
+        if (try_intrinsic(*fn, fn + 1, in->c, r[in->a]))
+            VM_NEXT();
+        auto last = fn + in->c + 1;
+        auto error = std::find_if(fn, last, [](auto& e) { return is_error(e); });
+        r[in->a] = error != last ? *error : call_function(env, *fn, fn + 1, in->c);
+        VM_NEXT();
+    }
+
+    VM_CASE(tail_call):
+    {
+        auto fn = r + in->b;
+        auto last = fn + in->c + 1;
+        auto error = std::find_if(fn, last, [](auto& e) { return is_error(e); });
+        if (error != last)
+            return *error;
+        expression result;
+        if (try_intrinsic(*fn, fn + 1, in->c, result))
+            return result;
+        if (fn->get_tag() != expression::tag::closure)
+            return call_function(env, *fn, fn + 1, in->c);
+        auto next = dynamic_cast<const bytecode_lambda *>(as_closure(*fn).code.get());
+        if (!next)
+            return call_function(env, *fn, fn + 1, in->c);
+        auto& o = next->find_overload(in->c);
+        boost::container::small_vector<expression, 8> args(std::make_move_iterator(fn + 1), std::make_move_iterator(last));
+        callee = std::move(*fn);
+        f.slots.resize(o.code.num_registers);
+        std::move(args.begin(), args.end(), f.slots.begin());
+        f.self = &as_closure(callee);
+        code = &o.code;
+        r = f.slots.data();
+        ip = code->code.data();
+        VM_NEXT();
+    }
+
+    VM_CASE(jump):
+        ip = code->code.data() + in->a;
+        VM_NEXT();
+
+    VM_CASE(jump_if_false):
+        if (r[in->a] == false || r[in->a] == nil)
+            ip = code->code.data() + in->b;
+        VM_NEXT();
+
+    VM_CASE(jump_if_not_error):
+        if (!is_error(r[in->a]))
+            ip = code->code.data() + in->b;
+        VM_NEXT();
+
+    VM_CASE(unwrap_error):
+        r[in->a] = apply([](auto& e) { return unwrap_error(e); }, r[in->a]);
+        VM_NEXT();
+
+    VM_CASE(check_undefined):
+        if (code->globals[in->a]->is_bound)
+            throw symbol_already_defined(code->globals[in->a]->name);
+        VM_NEXT();
+
+    VM_CASE(define):
+    {
+        auto& v = *code->globals[in->a];
+        v.value = std::move(r[in->b]);
+        v.is_bound = true;
+        r[in->b] = nil;
+        VM_NEXT();
+    }
+
+    VM_CASE(define_generic):
+    {
+        auto& v = *code->globals[in->a];
+        if (!v.is_bound)
+        {
+            v.value = generic_method(v.name);
+            v.is_bound = true;
+        }
+        r[in->b] = nil;
+        VM_NEXT();
+    }
+
+    VM_CASE(define_method):
+    {
+        auto& v = *code->globals[in->a];
+        if (!v.is_bound)
+            throw undefined_symbol_error(v.name);
+        define_method(as_generic_method(v.value), r[in->b]);
+        r[in->b] = nil;
+        VM_NEXT();
+    }
+
+    VM_CASE(return_):
+        return r[in->a];
+
+#ifndef CIMM_THREADED_DISPATCH
+    }
+    }
+#endif
+#undef VM_CASE
+#undef VM_NEXT
+}
+
+}
+
+auto bytecode_lambda::call(environment& env, const closure& self, const expression *args, integer num_args) const -> expression
+{
+    auto& o = find_overload(num_args);
+    frame f;
+    f.slots.resize(o.code.num_registers);
+    f.self = &self;
+    std::copy(args, args + num_args, f.slots.begin());
+    return run(env, o.code, f);
+}
+
+auto bytecode_lambda::find_overload(integer num_args) const -> const overload&
+{
+    auto o = std::find_if(begin(overloads), end(overloads), [&](auto& o) { return o.arity == num_args; });
+    if (o == end(overloads))
+        throw arity_error(num_args, "fn");
+    return *o;
+}
+
+auto execute_bytecode(environment& env, const chunk& code) -> expression
+{
+    frame f;
+    f.slots.resize(code.num_registers);
+    return run(env, code, f);
+}
+
+}
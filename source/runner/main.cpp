@@ -1,30 +1,53 @@
 #include <cimm/parse.hpp>
 #include <cimm/eval.hpp>
+#include <cimm/compile.hpp>
+#include <cimm/bytecode.hpp>
 #include <cimm/default_environment.hpp>
 #include <cimm/error.hpp>
 #include <iostream>
 #include <fstream>
+#include <cstring>
 
-void run(std::istream& is)
+using engine_function = cimm::expression(*)(cimm::environment&, const cimm::expression&);
+
+void run(std::istream& is, engine_function evaluate)
 {
     std::string source{std::istreambuf_iterator<char>{is}, std::istreambuf_iterator<char>{}};
     auto exprs = cimm::parse_expressions(source);
 
     auto environment = cimm::create_default_environment();
     for (auto expr : exprs)
-        cimm::evaluate_expression(environment, expr);
+        evaluate(environment, expr);
+}
+
+engine_function get_engine(const char *name)
+{
+    if (std::strcmp(name, "eval") == 0)
+        return cimm::evaluate_expression;
+    if (std::strcmp(name, "compile") == 0)
+        return cimm::evaluate_compiled;
+    if (std::strcmp(name, "vm") == 0)
+        return cimm::evaluate_bytecode;
+    throw std::invalid_argument(std::string("unknown engine: ") + name);
 }
 
 int main(int argc, const char *const *argv)
 {
     try
     {
+        engine_function evaluate = cimm::evaluate_expression;
+        if (argc > 1 && std::strncmp(argv[1], "--engine=", 9) == 0)
+        {
+            evaluate = get_engine(argv[1] + 9);
+            --argc;
+            ++argv;
+        }
         if (argc == 1)
-            run(std::cin);
+            run(std::cin, evaluate);
         else
         {
             std::ifstream f(argv[1]);
-            run(f);
+            run(f, evaluate);
         }
     }
     catch (cimm::parse_error const& e)
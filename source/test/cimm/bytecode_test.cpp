@@ -0,0 +1,64 @@
+#include "eval_test.hpp"
+
+namespace cimm
+{
+
+struct bytecode_test : eval_test
+{
+    auto execute_parsed(const string& expr)
+    {
+        return evaluate_bytecode(env, parse_expression(expr));
+    }
+};
+
+TEST_F(bytecode_test, instructions_should_be_compact)
+{
+    EXPECT_EQ(8u, sizeof(instruction));
+}
+
+TEST_F(bytecode_test, should_execute_a_compiled_chunk_repeatedly)
+{
+    evaluate_parsed("(def x 1)");
+    auto code = compile_bytecode(env, parse_expression("(if (= x 1) (+ x 2) :no)"));
+    EXPECT_EQ(integer(3), execute_bytecode(env, code));
+    EXPECT_EQ(integer(3), execute_bytecode(env, code));
+}
+
+TEST_F(bytecode_test, should_keep_constants_in_a_pool)
+{
+    auto code = compile_bytecode(env, parse_expression("'(1 2)"));
+    ASSERT_EQ(1u, code.constants.size());
+    EXPECT_EQ((list{integer(1), integer(2)}), code.constants[0]);
+}
+
+TEST_F(bytecode_test, should_jump_over_branches_of_nested_ifs)
+{
+    EXPECT_EQ(keyword("b"), execute_parsed("(if (if false true nil) :a (if true :b :c))"));
+    EXPECT_EQ(integer(3), execute_parsed("((fn [x] (if (< x 0) (- x) (if (= x 0) 0 x))) 3)"));
+    EXPECT_EQ(integer(3), execute_parsed("((fn [x] (if (< x 0) (- x) (if (= x 0) 0 x))) -3)"));
+}
+
+TEST_F(bytecode_test, should_capture_locals_of_all_enclosing_functions)
+{
+    EXPECT_EQ(integer(7), execute_parsed("((((fn [a] (fn [b] (fn [c] (+ a b c)))) 1) 2) 4)"));
+    EXPECT_EQ(integer(6), execute_parsed("(let [a 1 b 2] ((fn ([] (+ a b)) ([c] (+ a b c))) 3))"));
+}
+
+TEST_F(bytecode_test, should_resolve_repeated_names_like_the_evaluator)
+{
+    for (auto& source : {"(let [x 1 x 2] x)", "((fn [y y] y) 1 2)", "(loop [x 1 x 2] x)", "(let [x 1] ((fn [x x] x) 2 3))"})
+    {
+        auto expected = evaluate_expression(env, parse_expression(source));
+        EXPECT_EQ(expected, execute_parsed(source)) << source;
+        EXPECT_EQ(expected, evaluate_compiled(env, parse_expression(source))) << source;
+    }
+}
+
+TEST_F(bytecode_test, should_call_functions_created_by_other_engines)
+{
+    evaluate_compiled(env, parse_expression("(def add (fn [x y] (+ x y)))"));
+    execute_parsed("(def add3 (fn [x] (add x 3)))");
+    EXPECT_EQ(integer(7), evaluate_expression(env, parse_expression("(add3 4)")));
+}
+
+}
@@ -0,0 +1,48 @@
+#include "eval_test.hpp"
+
+namespace cimm
+{
+
+struct compile_test : eval_test
+{
+    auto execute_parsed(const string& expr)
+    {
+        return evaluate_compiled(env, parse_expression(expr));
+    }
+};
+
+TEST_F(compile_test, should_execute_a_compiled_expression_repeatedly)
+{
+    evaluate_parsed("(def x 1)");
+    auto code = compile_expression(env, parse_expression("(+ x 2)"));
+    EXPECT_EQ(integer(3), execute_compiled(env, code));
+    EXPECT_EQ(integer(3), execute_compiled(env, code));
+}
+
+TEST_F(compile_test, should_resolve_globals_defined_after_compilation)
+{
+    auto code = compile_expression(env, parse_expression("(late 4)"));
+    evaluate_parsed("(def late (fn [x] (* x x)))");
+    EXPECT_EQ(integer(16), execute_compiled(env, code));
+}
+
+TEST_F(compile_test, should_capture_locals_of_all_enclosing_functions)
+{
+    EXPECT_EQ(integer(7), execute_parsed("((((fn [a] (fn [b] (fn [c] (+ a b c)))) 1) 2) 4)"));
+    EXPECT_EQ(integer(6), execute_parsed("(let [a 1 b 2] ((fn ([] (+ a b)) ([c] (+ a b c))) 3))"));
+}
+
+TEST_F(compile_test, should_not_reuse_slots_of_let_bindings_being_evaluated)
+{
+    EXPECT_EQ((vector{integer(1), integer(2)}), execute_parsed("(let [a 1 b (let [c 2] c)] [a b])"));
+}
+
+TEST_F(compile_test, should_call_functions_evaluated_by_another_engine)
+{
+    evaluate_expression(env, parse_expression("(def add (fn [x y] (+ x y)))"));
+    execute_parsed("(def add3 (fn [x] (add x 3)))");
+    EXPECT_EQ(integer(5), execute_parsed("(add 2 3)"));
+    EXPECT_EQ(integer(7), evaluate_expression(env, parse_expression("(add3 4)")));
+}
+
+}
@@ -62,4 +62,25 @@ TEST_F(def_test, should_alias_functions)
     ASSERT_EQ(integer(5), evaluate(list{symbol("add"), integer(2), integer(3)}));
 }
 
+TEST_F(def_test, should_keep_one_var_per_symbol)
+{
+    auto v = get_var(env, symbol("later"));
+    EXPECT_EQ(v, get_var(env, symbol("later")));
+    EXPECT_THROW(evaluate(symbol("later")), undefined_symbol_error);
+    evaluate(list{special::def, symbol("later"), integer(3)});
+    EXPECT_EQ(integer(3), v->value);
+    EXPECT_EQ(integer(3), evaluate(symbol("later")));
+}
+
+TEST_F(def_test, redefinition_should_update_the_var_in_place)
+{
+    evaluate_parsed("(def x 1)");
+    auto code = compile_expression(env, parse("(+ x 1)"));
+    auto chunk = compile_bytecode(env, parse("(+ x 1)"));
+    redefine(env, symbol("x"), integer(10));
+    EXPECT_EQ(integer(11), execute_compiled(env, code));
+    EXPECT_EQ(integer(11), execute_bytecode(env, chunk));
+    EXPECT_EQ(integer(11), evaluate_parsed("(+ x 1)"));
+}
+
 }
@@ -52,6 +52,20 @@ TEST_F(eval_test, should_fail_when_given_no_arguments_to_minus)
     assert_arity_error(0, "-", "(-)");
 }
 
+TEST_F(eval_test, should_call_redefined_arithmetic_functions)
+{
+    evaluate_parsed("(def add-two (fn [x] (if (< x 0) 0 (+ x 2))))");
+    EXPECT_EQ(integer(5), evaluate_parsed("(add-two 3)"));
+
+    define_native_function(env, {"+", [](argument_span) -> expression { return integer(42); }});
+    define_native_function(env, {"<", [](argument_span) -> expression { return boolean(true); }});
+
+    EXPECT_EQ(integer(42), evaluate_parsed("(+ 1 2)"));
+    EXPECT_EQ(integer(0), evaluate_parsed("(add-two 3)"));
+    define_native_function(env, {"<", [](argument_span) -> expression { return boolean(false); }});
+    EXPECT_EQ(integer(42), evaluate_parsed("(add-two 3)"));
+}
+
 TEST_F(eval_test, should_fail_when_given_undefined_function)
 {
     assert_evaluation_error<undefined_symbol_error>("undefined symbol \'bad\'", "(bad)");
@@ -86,6 +100,53 @@ TEST_F(eval_test, should_execute_functions_with_specified_arity_from_the_environ
     EXPECT_EQ(integer(-1), evaluate_expression(env, list{symbol("func-2"), integer(2), integer(3)}));
 }
 
+TEST_F(eval_test, should_execute_functions_taking_an_argument_span_from_the_environment)
+{
+    environment env;
+    auto sum = [](argument_span args) -> expression
+    {
+        integer s{0};
+        for (auto& a : args)
+            s += as_integer(a);
+        return s;
+    };
+
+    define_native_function(env, {"sum", sum});
+
+    EXPECT_EQ(integer(0), evaluate_expression(env, list{symbol("sum")}));
+    EXPECT_EQ(integer(6), evaluate_expression(env, list{symbol("sum"), integer(1), integer(2), integer(3)}));
+    EXPECT_EQ(integer(6), call_function(env, native_function{"sum", sum}, list{integer(1), integer(2), integer(3)}));
+}
+
+TEST_F(eval_test, should_execute_typed_functions_from_the_environment)
+{
+    env = {};
+    define_native_function(env, "add", [](integer a, integer b) { return a + b; });
+    define_native_function(env, "nth-char", [](const string& s, integer i) { return string{std::string(1, s.c_str()[i])}; });
+    define_native_function(env, "size", [](const vector& v) { return count(v); });
+    define_native_function(env, "negate", [](boolean b) { return !b; });
+    define_native_function(env, "name", [](const symbol& s) { return pr_str(s); });
+    define_native_function(env, "ignore", [](const expression&) { });
+
+    EXPECT_EQ(integer(5), evaluate_parsed("(add 2 3)"));
+    EXPECT_EQ(expression(string{"b"}), evaluate_parsed("(nth-char \"abc\" 1)"));
+    EXPECT_EQ(integer(3), evaluate_parsed("(size [1 2 3])"));
+    EXPECT_EQ(boolean(false), evaluate_parsed("(negate true)"));
+    EXPECT_EQ(expression(string{"abc"}), evaluate_parsed("(name 'abc)"));
+    EXPECT_EQ(nil, evaluate_parsed("(ignore 1)"));
+    EXPECT_EQ(integer(5), call_function(env, make_native_function("add", [](integer a, integer b) { return a + b; }), list{integer(2), integer(3)}));
+}
+
+TEST_F(eval_test, should_check_arity_and_argument_types_of_typed_functions)
+{
+    env = {};
+    define_native_function(env, "add", [](integer a, integer b) { return a + b; });
+
+    assert_arity_error(1, "add", "(add 2)");
+    assert_arity_error(3, "add", "(add 2 3 4)");
+    assert_evaluation_error<type_error>("\"x\" is not an integer", "(add 2 \"x\")");
+}
+
 TEST_F(eval_test, should_fail_when_executing_a_functions_with_specified_arity_from_the_environment_with_mismatched_number_of_args)
 {
     env = {};
@@ -175,6 +236,7 @@ TEST_F(eval_test, should_check_if_integers_are_in_ascending_order)
     EXPECT_EQ(boolean(false), evaluate_parsed("(< 1 2 2)"));
     EXPECT_EQ(boolean(false), evaluate_parsed("(< 1 2 1)"));
     EXPECT_EQ(boolean(false), evaluate_parsed("(< 2 2 2)"));
+    assert_arity_error(0, "<", "(<)");
 }
 
 TEST_F(eval_test, should_evaluate_elements_of_a_vector)
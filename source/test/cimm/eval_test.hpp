@@ -1,5 +1,7 @@
 #include <gtest/gtest.h>
 #include <cimm/eval.hpp>
+#include <cimm/compile.hpp>
+#include <cimm/bytecode.hpp>
 #include <cimm/error.hpp>
 #include <cimm/default_environment.hpp>
 #include "expression_ostream.hpp"
@@ -8,13 +10,21 @@
 namespace cimm
 {
 
+using engine_function = expression(*)(environment&, const expression&);
+
+inline auto test_engine() -> engine_function&
+{
+    static engine_function engine = evaluate_expression;
+    return engine;
+}
+
 struct eval_test : testing::Test
 {
     environment env = create_default_environment();
 
     auto evaluate(const expression& expr)
     {
-        return evaluate_expression(env, expr);
+        return test_engine()(env, expr);
     }
 
     auto evaluate_parsed(const string& expr)
@@ -20,6 +20,16 @@ inline auto operator<<(std::ostream& os, const vector& v) -> std::ostream&
     return os << pr_str(v);
 }
 
+inline auto operator<<(std::ostream& os, const hash_map& m) -> std::ostream&
+{
+    return os << pr_str(m);
+}
+
+inline auto operator<<(std::ostream& os, const hash_set& s) -> std::ostream&
+{
+    return os << pr_str(s);
+}
+
 inline auto operator<<(std::ostream& os, const symbol& s) -> std::ostream&
 {
     return os << pr_str(s);
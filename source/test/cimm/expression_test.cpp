@@ -0,0 +1,133 @@
+#include <gtest/gtest.h>
+#include <cimm/expression.hpp>
+#include "expression_ostream.hpp"
+
+namespace cimm
+{
+
+TEST(expression_test, should_fit_in_two_words)
+{
+    EXPECT_LE(sizeof(expression), 2 * sizeof(void *));
+}
+
+TEST(expression_test, should_be_nil_when_default_constructed)
+{
+    EXPECT_EQ(nil, expression{});
+    EXPECT_EQ(expression::tag::nil, expression{}.get_tag());
+}
+
+TEST(expression_test, should_hold_immediate_values)
+{
+    EXPECT_EQ(expression::tag::integer, expression(integer(7)).get_tag());
+    EXPECT_EQ(expression::tag::boolean, expression(true).get_tag());
+    EXPECT_EQ(expression::tag::symbol, expression(symbol("a")).get_tag());
+    EXPECT_EQ(expression::tag::keyword, expression(keyword("a")).get_tag());
+    EXPECT_EQ(integer(7), expression(integer(7)));
+    EXPECT_EQ(symbol("a"), expression(symbol("a")));
+    EXPECT_EQ(keyword("a"), expression(keyword("a")));
+}
+
+TEST(expression_test, should_not_be_equal_to_values_of_other_types)
+{
+    EXPECT_NE(expression(integer(1)), expression(true));
+    EXPECT_NE(expression(symbol("a")), expression(keyword("a")));
+    EXPECT_NE(expression(string("a")), expression(symbol("a")));
+    EXPECT_NE(expression(list{}), expression(vector{}));
+    EXPECT_NE(nil, expression(false));
+}
+
+TEST(expression_test, should_compare_boxed_values_by_value)
+{
+    EXPECT_EQ(expression(string("abc")), expression(string("abc")));
+    EXPECT_NE(expression(string("abc")), expression(string("abd")));
+    EXPECT_EQ(expression(list{integer(1), integer(2)}), expression(list{integer(1), integer(2)}));
+    EXPECT_EQ(expression(vector{integer(1)}), expression(vector{integer(1)}));
+    EXPECT_EQ(expression(hash_map{{integer(1), integer(2)}}), expression(hash_map{{integer(1), integer(2)}}));
+    EXPECT_NE(expression(hash_map{{integer(1), integer(2)}}), expression(hash_map{{integer(1), integer(3)}}));
+}
+
+TEST(expression_test, should_hash_equal_values_equally)
+{
+    std::hash<expression> h;
+    EXPECT_EQ(h(string("abc")), h(string("abc")));
+    EXPECT_EQ(h(list{integer(1), vector{symbol("a")}}), h(list{integer(1), vector{symbol("a")}}));
+    EXPECT_EQ(h(hash_map{{integer(1), integer(2)}, {integer(3), integer(4)}}), h(hash_map{{integer(3), integer(4)}, {integer(1), integer(2)}}));
+    EXPECT_NE(h(list{integer(1), integer(2)}), h(list{integer(2), integer(1)}));
+    EXPECT_EQ(h(hash_set{integer(1), integer(2)}), h(hash_set{integer(2), integer(1)}));
+    EXPECT_NE(h(list{integer(1)}), h(vector{integer(1)}));
+    EXPECT_NE(h(symbol("a")), h(keyword("a")));
+}
+
+TEST(expression_test, should_hash_every_type_consistently_with_equality)
+{
+    std::hash<expression> h;
+    EXPECT_EQ(h(nil), h(nil));
+    EXPECT_EQ(h(integer(7)), h(integer(7)));
+    EXPECT_EQ(h(true), h(true));
+    EXPECT_EQ(h(error(integer(1))), h(error(integer(1))));
+    EXPECT_NE(h(error(integer(1))), h(error(integer(2))));
+    EXPECT_EQ(h(generic_method(symbol("m"))), h(generic_method(symbol("m"))));
+    EXPECT_EQ(std::hash<vector>()(vector{integer(1)}), h(vector{integer(1)}));
+    EXPECT_EQ(std::hash<list>()(list{integer(1)}), h(list{integer(1)}));
+    EXPECT_EQ(std::hash<hash_map>()(hash_map{{integer(1), integer(2)}}), h(hash_map{{integer(1), integer(2)}}));
+    EXPECT_EQ(std::hash<hash_set>()(hash_set{integer(1)}), h(hash_set{integer(1)}));
+}
+
+TEST(expression_test, should_reuse_the_hash_of_a_boxed_value)
+{
+    std::vector<expression> elems;
+    for (integer i = 0; i < 1000; ++i)
+        elems.push_back(vector{integer(i), string(std::to_string(i))});
+    expression v{vector(elems)};
+    auto copy = v;
+    auto h = v.std_hash();
+    EXPECT_EQ(h, v.std_hash());
+    EXPECT_EQ(h, copy.std_hash());
+    EXPECT_EQ(h, expression(vector(elems)).std_hash());
+    EXPECT_EQ(h, std::hash<vector>()(vector(elems)));
+}
+
+TEST(expression_test, should_hash_equal_collections_equally_whatever_their_structure)
+{
+    std::vector<expression> elems;
+    for (integer i = 0; i < 1000; ++i)
+        elems.push_back(integer(i));
+    vector v(elems);
+    auto h = v.std_hash();
+    EXPECT_EQ(h, expression(v).std_hash());
+    EXPECT_EQ(h, concat(subvec(v, 0, 333), subvec(v, 333, 1000)).std_hash());
+    EXPECT_EQ(h, conj(subvec(v, 0, 999), integer(999)).std_hash());
+    EXPECT_EQ(subvec(v, 1, 1000).std_hash(), rest(v).std_hash());
+    EXPECT_EQ(vector(std::vector<expression>(elems.begin() + 1, elems.end())).std_hash(), rest(v).std_hash());
+
+    hash_map m, reversed;
+    for (integer i = 0; i < 100; ++i)
+    {
+        m = assoc(m, integer(i), v);
+        reversed = assoc(reversed, integer(99 - i), v);
+    }
+    EXPECT_EQ(m.std_hash(), expression(reversed).std_hash());
+    EXPECT_EQ(m.std_hash(), assoc(dissoc(m, integer(5)), integer(5), v).std_hash());
+    EXPECT_EQ(std::hash<hash_map>()(m), std::hash<expression>()(m));
+}
+
+TEST(expression_test, should_share_boxed_values_between_copies)
+{
+    expression s{string("abc")};
+    auto copy = s;
+    auto moved = std::move(copy);
+    EXPECT_EQ(nil, copy);
+    EXPECT_EQ(string("abc"), moved);
+    EXPECT_EQ(string("abc"), s);
+}
+
+TEST(expression_test, should_not_change_copies_of_a_generic_method_when_it_is_modified)
+{
+    expression m{generic_method(symbol("m"))};
+    auto copy = m;
+    define_method(as_generic_method(m), integer(1));
+    EXPECT_EQ(1u, get_concrete_methods(as_generic_method(m), list{}).size());
+    EXPECT_EQ(0u, get_concrete_methods(as_generic_method(copy), list{}).size());
+}
+
+}
@@ -73,6 +73,14 @@ TEST_F(fn_test, should_not_apply_parameters_overridden_by_an_inner_function)
     EXPECT_EQ(integer(6), evaluate_parsed("((fn [x y z] ((fn [x] ((fn [y] (+ x y z)) 2)) 1)) 9 8 3)"));
 }
 
+TEST_F(fn_test, should_capture_parameters_of_enclosing_functions)
+{
+    evaluate_parsed("(def make-adder (fn [x] (fn [y] (+ x y))))");
+    evaluate_parsed("(def add5 (make-adder 5))");
+    EXPECT_EQ(integer(12), evaluate_parsed("(add5 7)"));
+    EXPECT_EQ(integer(3), evaluate_parsed("((make-adder 1) 2)"));
+}
+
 TEST_F(fn_test, should_not_apply_parameters_inside_quote)
 {
     EXPECT_EQ(symbol("x"), evaluate_parsed("((fn [x] 'x) 5)"));
@@ -89,6 +97,12 @@ TEST_F(fn_test, should_define_functions_overloaded_by_parameter_count)
     EXPECT_EQ(integer(3), evaluate_parsed("((fn ([x] x) ([x y] y) ([x y z] z)) 1 2 3)"));
 }
 
+TEST_F(fn_test, later_parameters_should_hide_earlier_parameters_with_the_same_name)
+{
+    EXPECT_EQ(integer{2}, evaluate_parsed("((fn [y y] y) 1 2)"));
+    EXPECT_EQ(integer{3}, evaluate_parsed("((fn [y x y] y) 1 2 3)"));
+}
+
 TEST_F(fn_test, should_fail_when_called_with_invalid_number_of_arguments)
 {
     assert_arity_error(2, "fn", "((fn ([x] x)) 3 3)");
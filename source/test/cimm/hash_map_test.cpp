@@ -0,0 +1,97 @@
+#include "eval_test.hpp"
+#include <cimm/error.hpp>
+#include <cimm/type_error.hpp>
+
+namespace cimm
+{
+
+struct hash_map_test : eval_test { };
+
+TEST_F(hash_map_test, should_evaluate_keys_and_values_of_map_literals)
+{
+    EXPECT_EQ(parse("{}"), evaluate_parsed("{}"));
+    EXPECT_EQ(parse("{:a 3 2 \"x\"}"), evaluate_parsed("{:a (+ 1 2) (+ 1 1) \"x\"}"));
+    EXPECT_EQ(parse("{:a 5}"), evaluate_parsed("(let [x 5] {:a x})"));
+    EXPECT_EQ(parse("{:a 5}"), evaluate_parsed("((fn [x] {:a x}) 5)"));
+}
+
+TEST_F(hash_map_test, should_evaluate_map_literal_forms_in_source_order)
+{
+    vector logged;
+    define_native_function(env, "log", [&](const expression& e) { logged = conj(logged, e); return e; });
+    EXPECT_EQ(parse("{:a :b :c :d 1 2 :e :f}"), evaluate_parsed("{(log :a) (log :b) (log :c) (log :d) (log 1) (log 2) (log :e) (log :f)}"));
+    EXPECT_EQ(parse("[:a :b :c :d 1 2 :e :f]"), expression(logged));
+}
+
+TEST_F(hash_map_test, should_evaluate_all_forms_of_equal_map_literal_keys)
+{
+    vector logged;
+    define_native_function(env, "log", [&](const expression& e) { logged = conj(logged, e); return e; });
+    EXPECT_EQ(parse("{:a 2}"), evaluate_parsed("{(log :a) (log 1) (log :a) (log 2)}"));
+    EXPECT_EQ(parse("[:a 1 :a 2]"), expression(logged));
+    EXPECT_EQ(parse("{1 2}"), evaluate_parsed("{(+ 0 1) 1 (+ 1 0) 2}"));
+}
+
+TEST_F(hash_map_test, should_create_a_map)
+{
+    EXPECT_EQ(parse("{}"), evaluate_parsed("(hash-map)"));
+    EXPECT_EQ(parse("{:a 1 :b 2}"), evaluate_parsed("(hash-map :b 2 :a 1)"));
+    EXPECT_EQ(parse("{:a 3}"), evaluate_parsed("(hash-map :a 1 :a 3)"));
+    assert_arity_error(1, "hash-map", "(hash-map :a)");
+}
+
+TEST_F(hash_map_test, assoc_should_add_or_replace_entries)
+{
+    EXPECT_EQ(parse("{:a 1}"), evaluate_parsed("(assoc {} :a 1)"));
+    EXPECT_EQ(parse("{:a 1 :b 2}"), evaluate_parsed("(assoc {:a 1} :b 2)"));
+    EXPECT_EQ(parse("{:a 2 :b 3}"), evaluate_parsed("(assoc {:a 1} :a 2 :b 3)"));
+    EXPECT_EQ(parse("{:a 1}"), evaluate_parsed("(assoc nil :a 1)"));
+    assert_arity_error(2, "assoc", "(assoc {} :a)");
+    assert_evaluation_error<type_error>("[] is not a map", "(assoc [] :a 1)");
+}
+
+TEST_F(hash_map_test, dissoc_should_remove_entries)
+{
+    EXPECT_EQ(parse("{:b 2}"), evaluate_parsed("(dissoc {:a 1 :b 2} :a)"));
+    EXPECT_EQ(parse("{}"), evaluate_parsed("(dissoc {:a 1 :b 2} :a :b)"));
+    EXPECT_EQ(parse("{:a 1}"), evaluate_parsed("(dissoc {:a 1} :c)"));
+    EXPECT_EQ(parse("{:a 1}"), evaluate_parsed("(dissoc {:a 1})"));
+    EXPECT_EQ(nil, evaluate_parsed("(dissoc nil :a)"));
+}
+
+TEST_F(hash_map_test, get_should_return_the_value_for_a_key)
+{
+    EXPECT_EQ(parse("1"), evaluate_parsed("(get {:a 1 :b 2} :a)"));
+    EXPECT_EQ(parse("[1]"), evaluate_parsed("(get {[1 2] [1] :b 2} [1 2])"));
+    EXPECT_EQ(parse("(1)"), evaluate_parsed("(get {[1 2] [1] '(1 2) '(1)} '(1 2))"));
+    EXPECT_EQ(parse("2"), evaluate_parsed("(get {{:a 1} 2} {:a 1})"));
+    EXPECT_EQ(nil, evaluate_parsed("(get {:a 1} :b)"));
+    EXPECT_EQ(nil, evaluate_parsed("(get nil :b)"));
+    EXPECT_EQ(parse(":none"), evaluate_parsed("(get {:a 1} :b :none)"));
+    EXPECT_EQ(parse(":none"), evaluate_parsed("(get nil :b :none)"));
+    assert_arity_error(1, "get", "(get {})");
+}
+
+TEST_F(hash_map_test, count_should_return_the_number_of_entries)
+{
+    EXPECT_EQ(parse("0"), evaluate_parsed("(count {})"));
+    EXPECT_EQ(parse("2"), evaluate_parsed("(count {:a 1 :b 2})"));
+}
+
+TEST_F(hash_map_test, should_compare_maps_by_entries)
+{
+    EXPECT_EQ(parse("true"), evaluate_parsed("(= {:a 1 :b 2} {:b 2 :a 1})"));
+    EXPECT_EQ(parse("false"), evaluate_parsed("(= {:a 1} {:a 2})"));
+    EXPECT_EQ(parse("false"), evaluate_parsed("(= {:a 1} {:a 1 :b 2})"));
+    EXPECT_EQ(parse("false"), evaluate_parsed("(= {} [])"));
+}
+
+TEST_F(hash_map_test, should_hold_many_entries)
+{
+    evaluate_parsed("(def m (loop [m {} i 0] (if (< i 2000) (recur (assoc m i (* i i)) (+ i 1)) m)))");
+    EXPECT_EQ(parse("2000"), evaluate_parsed("(count m)"));
+    EXPECT_EQ(parse("1522756"), evaluate_parsed("(get m 1234)"));
+    EXPECT_EQ(nil, evaluate_parsed("(get m 2000)"));
+}
+
+}
@@ -0,0 +1,76 @@
+#include "eval_test.hpp"
+#include <cimm/error.hpp>
+#include <cimm/type_error.hpp>
+
+namespace cimm
+{
+
+struct hash_set_test : eval_test { };
+
+TEST_F(hash_set_test, should_evaluate_elements_of_set_literals)
+{
+    EXPECT_EQ(parse("#{}"), evaluate_parsed("#{}"));
+    EXPECT_EQ(parse("#{:a 3}"), evaluate_parsed("#{:a (+ 1 2)}"));
+    EXPECT_EQ(parse("#{2}"), evaluate_parsed("#{(+ 1 1) (* 2 1)}"));
+    EXPECT_EQ(parse("#{5 6}"), evaluate_parsed("(let [x 5] #{x 6})"));
+    EXPECT_EQ(parse("#{5}"), evaluate_parsed("((fn [x] #{x}) 5)"));
+}
+
+TEST_F(hash_set_test, should_evaluate_set_literal_forms_in_source_order)
+{
+    vector logged;
+    define_native_function(env, "log", [&](const expression& e) { logged = conj(logged, e); return e; });
+    EXPECT_EQ(parse("#{:a :b :c :d 1 2 :e}"), evaluate_parsed("#{(log :a) (log :b) (log :c) (log :d) (log 1) (log 2) (log :e)}"));
+    EXPECT_EQ(parse("[:a :b :c :d 1 2 :e]"), expression(logged));
+    logged = {};
+    EXPECT_EQ(parse("#{:a}"), evaluate_parsed("#{(log :a) (log :a)}"));
+    EXPECT_EQ(parse("[:a :a]"), expression(logged));
+}
+
+TEST_F(hash_set_test, should_create_a_set)
+{
+    EXPECT_EQ(parse("#{}"), evaluate_parsed("(hash-set)"));
+    EXPECT_EQ(parse("#{:a :b}"), evaluate_parsed("(hash-set :b :a :b)"));
+}
+
+TEST_F(hash_set_test, contains_should_test_membership)
+{
+    EXPECT_EQ(parse("true"), evaluate_parsed("(contains? #{:a [1 2]} [1 2])"));
+    EXPECT_EQ(parse("false"), evaluate_parsed("(contains? #{:a [1 2]} [1])"));
+    EXPECT_EQ(parse("true"), evaluate_parsed("(contains? {:a 1} :a)"));
+    EXPECT_EQ(parse("false"), evaluate_parsed("(contains? {:a 1} 1)"));
+    EXPECT_EQ(parse("false"), evaluate_parsed("(contains? nil 1)"));
+    assert_evaluation_error<type_error>("[] is not a set or a map", "(contains? [] 1)");
+}
+
+TEST_F(hash_set_test, conj_should_add_an_element)
+{
+    EXPECT_EQ(parse("#{1}"), evaluate_parsed("(conj #{} 1)"));
+    EXPECT_EQ(parse("#{1 2}"), evaluate_parsed("(conj #{1} 2)"));
+    EXPECT_EQ(parse("#{1}"), evaluate_parsed("(conj #{1} 1)"));
+}
+
+TEST_F(hash_set_test, disj_should_remove_elements)
+{
+    EXPECT_EQ(parse("#{2}"), evaluate_parsed("(disj #{1 2} 1)"));
+    EXPECT_EQ(parse("#{}"), evaluate_parsed("(disj #{1 2} 1 2)"));
+    EXPECT_EQ(parse("#{1}"), evaluate_parsed("(disj #{1} 3)"));
+    EXPECT_EQ(nil, evaluate_parsed("(disj nil 3)"));
+    assert_evaluation_error<type_error>("{} is not a set", "(disj {} 3)");
+}
+
+TEST_F(hash_set_test, count_should_return_the_number_of_elements)
+{
+    EXPECT_EQ(parse("0"), evaluate_parsed("(count #{})"));
+    EXPECT_EQ(parse("2"), evaluate_parsed("(count #{:a :b})"));
+}
+
+TEST_F(hash_set_test, should_compare_sets_by_elements)
+{
+    EXPECT_EQ(parse("true"), evaluate_parsed("(= #{1 2} #{2 1})"));
+    EXPECT_EQ(parse("false"), evaluate_parsed("(= #{1 2} #{1})"));
+    EXPECT_EQ(parse("false"), evaluate_parsed("(= #{} {})"));
+    EXPECT_EQ(parse("2"), evaluate_parsed("(get {#{1 2} 2} #{2 1})"));
+}
+
+}
@@ -18,6 +18,14 @@ TEST_F(keyword_test, should_make_keywords_from_the_first_parameter_only)
     EXPECT_EQ(expression(keyword("a")), evaluate(list{symbol("keyword"), string("a"), string("b")}));
 }
 
+TEST_F(keyword_test, should_be_interned)
+{
+    EXPECT_EQ(sizeof(void *), sizeof(keyword));
+    EXPECT_EQ(keyword("abc"), keyword(std::string("ab") + "c"));
+    EXPECT_EQ(std::hash<keyword>()(keyword("abc")), std::hash<keyword>()(keyword(std::string("ab") + "c")));
+    EXPECT_FALSE(keyword("abc") == keyword("abd"));
+}
+
 TEST_F(keyword_test, should_fail_for_no_parameters)
 {
     assert_arity_error(0, "keyword", "(keyword)");
@@ -46,6 +46,17 @@ TEST_F(let_test, function_bindings_should_hide_let_bindings)
     EXPECT_EQ(integer{9}, evaluate_parsed("(let [x 2] ((fn [x] (+ x 7)) x))"));
 }
 
+TEST_F(let_test, functions_should_capture_let_bindings)
+{
+    EXPECT_EQ(integer{5}, evaluate_parsed("((let [x 2] (fn [y] (+ x y))) 3)"));
+}
+
+TEST_F(let_test, later_bindings_should_hide_earlier_bindings_with_the_same_name)
+{
+    EXPECT_EQ(integer{2}, evaluate_parsed("(let [x 1 x 2] x)"));
+    EXPECT_EQ(evaluate_parsed("'(3 2)"), evaluate_parsed("(let [x 1 y 2 x 3] (list x y))"));
+}
+
 TEST_F(let_test, should_fail_for_odd_number_of_forms)
 {
     assert_evaluation_error<let_forms_error>("let requires an even number of forms in binding vector", "(let [x] 1)");
@@ -0,0 +1,96 @@
+#include "eval_test.hpp"
+
+namespace cimm
+{
+
+struct loop_test : eval_test { };
+
+TEST_F(loop_test, should_evaluate_the_body_with_the_initial_bindings)
+{
+    EXPECT_EQ(integer(1), evaluate_parsed("(loop [x 1] x)"));
+    EXPECT_EQ(evaluate_parsed("'(1 2)"), evaluate_parsed("(loop [a 1 b 2] (list a b))"));
+    EXPECT_EQ(integer(7), evaluate_parsed("(loop [] 7)"));
+}
+
+TEST_F(loop_test, should_rebind_the_bindings_and_repeat_the_body_on_recur)
+{
+    EXPECT_EQ(integer(4950), evaluate_parsed("(loop [i 0 acc 0] (if (= i 100) acc (recur (+ i 1) (+ acc i))))"));
+}
+
+TEST_F(loop_test, should_evaluate_recur_arguments_before_rebinding)
+{
+    EXPECT_EQ(evaluate_parsed("'(2 1)"), evaluate_parsed("(loop [a 1 b 2 n 0] (if (= n 1) (list a b) (recur b a 1)))"));
+}
+
+TEST_F(loop_test, should_run_in_constant_stack_space)
+{
+    EXPECT_EQ(integer(1000000), evaluate_parsed("(loop [i 0] (if (= i 1000000) i (recur (+ i 1))))"));
+}
+
+TEST_F(loop_test, recur_should_target_the_innermost_loop)
+{
+    EXPECT_EQ(integer(30), evaluate_parsed(
+        "(loop [i 0 acc 0]"
+        "  (if (= i 3)"
+        "    acc"
+        "    (recur (+ i 1) (+ acc (loop [j 0] (if (= j 10) j (recur (+ j 1))))))))"));
+}
+
+TEST_F(loop_test, should_recur_to_the_enclosing_function)
+{
+    EXPECT_EQ(integer(100000), evaluate_parsed("((fn [n acc] (if (= n 0) acc (recur (- n 1) (+ acc 1)))) 100000 0)"));
+    EXPECT_EQ(integer(3), evaluate_parsed("((fn ([] 0) ([n] (if (= n 3) n (recur (+ n 1))))) 0)"));
+}
+
+TEST_F(loop_test, closures_should_capture_the_bindings_of_each_iteration)
+{
+    EXPECT_EQ(integer(1), evaluate_parsed("(loop [i 0 fs []] (if (= i 3) ((nth fs 1)) (recur (+ i 1) (conj fs (fn [] i)))))"));
+}
+
+TEST_F(loop_test, functions_should_call_themselves_in_constant_stack_space)
+{
+    evaluate_parsed("(def count-down (fn [n] (if (= n 0) :done (count-down (- n 1)))))");
+    EXPECT_EQ(keyword("done"), evaluate_parsed("(count-down 1000000)"));
+}
+
+TEST_F(loop_test, mutually_recursive_functions_should_run_in_constant_stack_space)
+{
+    evaluate_parsed("(def is-even (fn [n] (if (= n 0) true (is-odd (- n 1)))))");
+    evaluate_parsed("(def is-odd (fn [n] (if (= n 0) false (is-even (- n 1)))))");
+    EXPECT_EQ(true, evaluate_parsed("(is-even 1000000)"));
+    EXPECT_EQ(false, evaluate_parsed("(is-odd 1000000)"));
+}
+
+TEST_F(loop_test, tail_calls_from_a_loop_should_return_the_called_function_result)
+{
+    evaluate_parsed("(def twice (fn [x] (* 2 x)))");
+    EXPECT_EQ(integer(20), evaluate_parsed("((fn [] (loop [i 0] (if (= i 10) (twice i) (recur (+ i 1))))))"));
+    EXPECT_EQ(integer(21), evaluate_parsed("(+ 1 (loop [i 0] (if (= i 10) (twice i) (recur (+ i 1)))))"));
+}
+
+TEST_F(loop_test, later_bindings_should_hide_earlier_bindings_with_the_same_name)
+{
+    EXPECT_EQ(integer{2}, evaluate_parsed("(loop [x 1 x 2] x)"));
+    EXPECT_EQ(integer{5}, evaluate_parsed("(loop [x 0 x 1] (if (< x 5) (recur 0 (+ x 1)) x))"));
+}
+
+TEST_F(loop_test, should_fail_when_recur_is_not_in_tail_position)
+{
+    assert_evaluation_error<recur_error>("can only recur from tail position", "(recur 1)");
+    assert_evaluation_error<recur_error>("can only recur from tail position", "(loop [x 1] (+ 1 (recur 2)))");
+    assert_evaluation_error<recur_error>("can only recur from tail position", "(loop [x 1] (if (recur 2) 1 2))");
+    assert_evaluation_error<recur_error>("can only recur from tail position", "((fn [x] (recur 2) x) 1)");
+}
+
+TEST_F(loop_test, should_fail_when_recur_has_a_wrong_number_of_arguments)
+{
+    assert_evaluation_error<recur_error>("mismatched argument count to recur, expected: 1 args, got: 2", "(loop [x 1] (recur 1 2))");
+    assert_evaluation_error<recur_error>("mismatched argument count to recur, expected: 2 args, got: 1", "((fn [x y] (recur 1)) 1 2)");
+}
+
+TEST_F(loop_test, should_fail_for_an_odd_number_of_binding_forms)
+{
+    assert_evaluation_error<let_forms_error>("loop requires an even number of forms in binding vector", "(loop [x] 1)");
+}
+
+}
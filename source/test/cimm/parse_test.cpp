@@ -139,6 +139,59 @@ TEST_F(parse_test, should_parse_a_vector_of_expressions)
     EXPECT_EQ(expression(vector{keyword("x")}), parse_expression("[:x]"));
 }
 
+TEST_F(parse_test, should_parse_a_vector_spanning_many_leaves)
+{
+    std::vector<expression> elems;
+    std::string text = "[";
+    for (integer i = 0; i < 1100; ++i)
+    {
+        elems.push_back(i);
+        text += " " + std::to_string(i);
+    }
+    text += "]";
+    EXPECT_EQ(expression(vector(elems)), parse_expression(text));
+}
+
+TEST_F(parse_test, should_parse_a_map_of_expressions)
+{
+    EXPECT_EQ(expression(hash_map{}), parse_expression("{}"));
+    EXPECT_EQ(expression(hash_map{}), parse_expression("{ }"));
+    EXPECT_EQ(expression(hash_map{{keyword("a"), integer(1)}}), parse_expression("{:a 1}"));
+    EXPECT_EQ(expression(hash_map{{symbol("x"), vector{integer(1)}}, {list{integer(2)}, hash_map{{integer(3), nil}}}}), parse_expression("{x [1] (2) {3 nil}}"));
+}
+
+TEST_F(parse_test, should_parse_a_set_of_expressions)
+{
+    EXPECT_EQ(expression(hash_set{}), parse_expression("#{}"));
+    EXPECT_EQ(expression(hash_set{keyword("a"), integer(1)}), parse_expression("#{:a 1}"));
+    EXPECT_EQ(expression(hash_set{symbol("x"), hash_set{integer(3)}}), parse_expression("#{x #{3}}"));
+    EXPECT_EQ(expression(symbol("a#b")), parse_expression("a#b"));
+}
+
+TEST_F(parse_test, should_fail_when_parsing_a_map_with_an_odd_number_of_forms)
+{
+    assert_parse_error("map literal must contain an even number of forms", "{:a 1 :b}");
+}
+
+TEST_F(parse_test, should_keep_the_last_value_of_duplicate_map_keys)
+{
+    EXPECT_EQ(expression(hash_map{{keyword("a"), integer(2)}}), parse_expression("{:a 1 :a 2}"));
+    EXPECT_EQ(expression(vector{keyword("a"), integer(1), keyword("a"), integer(2)}), source_forms(as_hash_map(parse_expression("{:a 1 :a 2}"))));
+    EXPECT_EQ(expression(hash_map{{list{symbol("f")}, integer(2)}}), parse_expression("{(f) 1 (f) 2}"));
+}
+
+TEST_F(parse_test, should_merge_duplicate_set_elements)
+{
+    EXPECT_EQ(expression(hash_set{keyword("a"), integer(1)}), parse_expression("#{:a 1 :a}"));
+    EXPECT_EQ(expression(vector{keyword("a"), integer(1), keyword("a")}), source_forms(as_hash_set(parse_expression("#{:a 1 :a}"))));
+    EXPECT_EQ(expression(hash_set{list{symbol("f")}}), parse_expression("#{(f) (f)}"));
+}
+
+TEST_F(parse_test, should_fail_when_parsing_an_unmatched_closing_brace)
+{
+    assert_parse_error("unexpected }", "}");
+}
+
 TEST_F(parse_test, should_fail_when_parsing_an_unmatched_closing_bracket)
 {
     assert_parse_error("unexpected ]", "]");
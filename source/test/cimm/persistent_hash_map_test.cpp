@@ -0,0 +1,156 @@
+#include <cimm/persistent_hash_map.hpp>
+#include <map>
+#include <string>
+#include <gtest/gtest.h>
+
+namespace cimm
+{
+
+struct persistent_hash_map_test : testing::Test
+{
+    struct colliding_hash
+    {
+        std::size_t operator()(int key) const { return key % 3; }
+    };
+
+    using int_map = persistent_hash_map<int, std::string>;
+    using colliding_map = persistent_hash_map<int, std::string, colliding_hash>;
+
+    template <typename map_type>
+    static std::map<int, std::string> entries(const map_type& m)
+    {
+        std::map<int, std::string> result;
+        m.for_each([&](int k, const std::string& v) { result.emplace(k, v); });
+        return result;
+    }
+};
+
+TEST_F(persistent_hash_map_test, should_be_empty_by_default)
+{
+    int_map m;
+    EXPECT_TRUE(m.empty());
+    EXPECT_EQ(0u, m.size());
+    EXPECT_EQ(nullptr, m.find(1));
+    EXPECT_TRUE(entries(m).empty());
+}
+
+TEST_F(persistent_hash_map_test, assoc_should_add_entries_without_modifying_the_original)
+{
+    int_map m0;
+    auto m1 = m0.assoc(1, "a");
+    auto m2 = m1.assoc(2, "b");
+
+    EXPECT_EQ(0u, m0.size());
+    EXPECT_EQ(1u, m1.size());
+    EXPECT_EQ(2u, m2.size());
+    EXPECT_FALSE(m1.contains(2));
+    EXPECT_EQ("a", *m2.find(1));
+    EXPECT_EQ("b", *m2.find(2));
+}
+
+TEST_F(persistent_hash_map_test, assoc_should_replace_the_value_of_an_existing_key)
+{
+    int_map m1{{1, "a"}, {2, "b"}};
+    auto m2 = m1.assoc(1, "c");
+
+    EXPECT_EQ(2u, m2.size());
+    EXPECT_EQ("c", *m2.find(1));
+    EXPECT_EQ("a", *m1.find(1));
+}
+
+TEST_F(persistent_hash_map_test, dissoc_should_remove_entries_without_modifying_the_original)
+{
+    int_map m1{{1, "a"}, {2, "b"}};
+    auto m2 = m1.dissoc(1);
+
+    EXPECT_EQ(1u, m2.size());
+    EXPECT_FALSE(m2.contains(1));
+    EXPECT_EQ("b", *m2.find(2));
+    EXPECT_EQ("a", *m1.find(1));
+    EXPECT_TRUE(m2.dissoc(2).empty());
+}
+
+TEST_F(persistent_hash_map_test, dissoc_should_ignore_missing_keys)
+{
+    int_map m{{1, "a"}};
+    EXPECT_EQ(m, m.dissoc(2));
+    EXPECT_EQ(1u, m.dissoc(2).size());
+    EXPECT_TRUE(int_map{}.dissoc(1).empty());
+}
+
+TEST_F(persistent_hash_map_test, should_hold_many_entries)
+{
+    const int n = 100000;
+    int_map m;
+    for (int i = 0; i < n; ++i)
+        m = m.assoc(i, std::to_string(i));
+    ASSERT_EQ(std::size_t(n), m.size());
+    for (int i = 0; i < n; ++i)
+        ASSERT_EQ(std::to_string(i), *m.find(i)) << i;
+    EXPECT_EQ(nullptr, m.find(n));
+
+    for (int i = 0; i < n; i += 2)
+        m = m.dissoc(i);
+    ASSERT_EQ(std::size_t(n / 2), m.size());
+    for (int i = 0; i < n; ++i)
+        ASSERT_EQ(i % 2 != 0, m.contains(i)) << i;
+    EXPECT_EQ(std::size_t(n / 2), entries(m).size());
+}
+
+TEST_F(persistent_hash_map_test, should_keep_entries_with_colliding_hashes)
+{
+    colliding_map m;
+    for (int i = 0; i < 30; ++i)
+        m = m.assoc(i, std::to_string(i));
+    m = m.assoc(4, "four");
+
+    ASSERT_EQ(30u, m.size());
+    EXPECT_EQ("four", *m.find(4));
+    for (int i = 0; i < 30; ++i)
+    {
+        if (i != 4)
+        {
+            EXPECT_EQ(std::to_string(i), *m.find(i));
+        }
+    }
+    EXPECT_EQ(nullptr, m.find(30));
+}
+
+TEST_F(persistent_hash_map_test, dissoc_should_remove_entries_with_colliding_hashes)
+{
+    colliding_map m;
+    for (int i = 0; i < 30; ++i)
+        m = m.assoc(i, std::to_string(i));
+    for (int i = 0; i < 30; i += 3)
+        m = m.dissoc(i);
+
+    EXPECT_EQ(20u, m.size());
+    for (int i = 0; i < 30; ++i)
+        EXPECT_EQ(i % 3 != 0, m.contains(i)) << i;
+    for (int i = 0; i < 30; ++i)
+        m = m.dissoc(i);
+    EXPECT_TRUE(m.empty());
+    EXPECT_EQ(nullptr, m.find(1));
+}
+
+TEST_F(persistent_hash_map_test, should_compare_entries_regardless_of_insertion_order)
+{
+    int_map m1, m2;
+    for (int i = 0; i < 1000; ++i)
+    {
+        m1 = m1.assoc(i, std::to_string(i));
+        m2 = m2.assoc(999 - i, std::to_string(999 - i));
+    }
+    EXPECT_EQ(m1, m2);
+    EXPECT_NE(m1, m2.assoc(5, "x"));
+    EXPECT_NE(m1, m2.dissoc(5));
+    EXPECT_EQ((int_map{{1, "a"}, {2, "b"}}), (int_map{{2, "b"}, {1, "a"}}));
+}
+
+TEST_F(persistent_hash_map_test, for_each_should_visit_every_entry_once)
+{
+    int_map m{{1, "a"}, {2, "b"}, {3, "c"}};
+    EXPECT_EQ((std::map<int, std::string>{{1, "a"}, {2, "b"}, {3, "c"}}), entries(m));
+}
+
+}
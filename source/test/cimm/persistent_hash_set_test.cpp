@@ -0,0 +1,95 @@
+#include <cimm/persistent_hash_set.hpp>
+#include <set>
+#include <gtest/gtest.h>
+
+namespace cimm
+{
+
+struct persistent_hash_set_test : testing::Test
+{
+    struct colliding_hash
+    {
+        std::size_t operator()(int key) const { return key % 3; }
+    };
+
+    using int_set = persistent_hash_set<int>;
+
+    template <typename set_type>
+    static std::set<int> elements(const set_type& s)
+    {
+        std::set<int> result;
+        s.for_each([&](int e) { result.insert(e); });
+        return result;
+    }
+};
+
+TEST_F(persistent_hash_set_test, should_be_empty_by_default)
+{
+    int_set s;
+    EXPECT_TRUE(s.empty());
+    EXPECT_EQ(0u, s.size());
+    EXPECT_FALSE(s.contains(1));
+}
+
+TEST_F(persistent_hash_set_test, insert_should_add_elements_without_modifying_the_original)
+{
+    int_set s0;
+    auto s1 = s0.insert(1);
+    auto s2 = s1.insert(2).insert(1);
+
+    EXPECT_EQ(0u, s0.size());
+    EXPECT_EQ(1u, s1.size());
+    EXPECT_EQ(2u, s2.size());
+    EXPECT_FALSE(s1.contains(2));
+    EXPECT_EQ((std::set<int>{1, 2}), elements(s2));
+}
+
+TEST_F(persistent_hash_set_test, erase_should_remove_elements_without_modifying_the_original)
+{
+    int_set s1{1, 2, 3};
+    auto s2 = s1.erase(2);
+
+    EXPECT_EQ((std::set<int>{1, 3}), elements(s2));
+    EXPECT_EQ((std::set<int>{1, 2, 3}), elements(s1));
+    EXPECT_EQ(s2, s2.erase(4));
+}
+
+TEST_F(persistent_hash_set_test, should_hold_many_elements)
+{
+    const int n = 100000;
+    int_set s;
+    for (int i = 0; i < n; ++i)
+        s = s.insert(i * 7);
+    ASSERT_EQ(std::size_t(n), s.size());
+    for (int i = 0; i < n * 7; ++i)
+        ASSERT_EQ(i % 7 == 0, s.contains(i)) << i;
+    for (int i = 0; i < n; i += 2)
+        s = s.erase(i * 7);
+    EXPECT_EQ(std::size_t(n / 2), s.size());
+    EXPECT_FALSE(s.contains(0));
+    EXPECT_TRUE(s.contains(7));
+}
+
+TEST_F(persistent_hash_set_test, should_keep_elements_with_colliding_hashes)
+{
+    persistent_hash_set<int, colliding_hash> s;
+    for (int i = 0; i < 30; ++i)
+        s = s.insert(i);
+    EXPECT_EQ(30u, s.size());
+    EXPECT_TRUE(s.contains(29));
+    EXPECT_FALSE(s.contains(30));
+    for (int i = 0; i < 30; i += 2)
+        s = s.erase(i);
+    EXPECT_EQ(15u, elements(s).size());
+    EXPECT_FALSE(s.contains(28));
+    EXPECT_TRUE(s.contains(29));
+}
+
+TEST_F(persistent_hash_set_test, should_compare_elements_regardless_of_insertion_order)
+{
+    EXPECT_EQ((int_set{1, 2, 3}), (int_set{3, 1, 2}));
+    EXPECT_NE((int_set{1, 2, 3}), (int_set{1, 2}));
+    EXPECT_NE((int_set{1, 2, 3}), (int_set{1, 2, 4}));
+}
+
+}
@@ -1,5 +1,7 @@
 #include <cimm/persistent_vector.hpp>
 #include <atomic>
+#include <list>
+#include <sstream>
 #include <gtest/gtest.h>
 
 namespace cimm
@@ -36,6 +38,29 @@ struct persistent_vector_test : testing::Test
         return v;
     }
 
+    std::vector<std::string> values(const string_vector& v)
+    {
+        std::vector<std::string> r;
+        for (auto& e : v)
+            r.push_back(e.value);
+        return r;
+    }
+
+    std::vector<std::string> values(const std::vector<traced_string>& n, std::size_t first, std::size_t last)
+    {
+        std::vector<std::string> r;
+        for (auto i = first; i < last; ++i)
+            r.push_back(n[i].value);
+        return r;
+    }
+
+    void assert_indexable(const string_vector& v)
+    {
+        auto expected = values(v);
+        for (std::size_t i = 0; i < v.size(); ++i)
+            ASSERT_EQ(expected[i], v[i].value) << "index " << i;
+    }
+
     void TearDown() override
     {
         ASSERT_EQ(0, trace_count);
@@ -140,6 +165,40 @@ TEST_F(persistent_vector_test, should_provide_iterator_pair_constructor)
     EXPECT_EQ("two", two.at(1).value);
 }
 
+TEST_F(persistent_vector_test, iterator_pair_constructor_should_build_the_same_vector_as_push_back)
+{
+    auto n = numbers(4 * 4 * 4 * 2 + 5);
+    std::list<traced_string> sequential(begin(n), end(n));
+    string_vector appended;
+    for (std::size_t size = 0; size <= n.size(); ++size)
+    {
+        string_vector random_access{begin(n), begin(n) + size};
+        string_vector forward{begin(sequential), std::next(begin(sequential), size)};
+        ASSERT_EQ(size, random_access.size());
+        ASSERT_TRUE(appended == random_access) << "size " << size;
+        ASSERT_TRUE(appended == forward) << "size " << size;
+        assert_indexable(random_access);
+        if (size > 0)
+        {
+            ASSERT_TRUE(random_access.pop_back() == appended.pop_back()) << "size " << size;
+        }
+        if (size < n.size())
+        {
+            ASSERT_TRUE(random_access.push_back(n[size]) == appended.push_back(n[size])) << "size " << size;
+            appended = appended.push_back(n[size]);
+        }
+    }
+}
+
+TEST_F(persistent_vector_test, iterator_pair_constructor_should_accept_input_iterators)
+{
+    std::istringstream input("1 2 3 4 5 6 7 8 9 10 11 12 13 14 15 16 17 18 19");
+    persistent_vector<int, 2> v{std::istream_iterator<int>(input), std::istream_iterator<int>()};
+    ASSERT_EQ(19u, v.size());
+    for (int i = 0; i < 19; ++i)
+        ASSERT_EQ(i + 1, v[i]);
+}
+
 TEST_F(persistent_vector_test, should_provide_indexing_operator)
 {
     auto two = string_vector{s("one"), s("two")};
@@ -219,6 +278,52 @@ TEST_F(persistent_vector_test, iterators_should_provide_indexing)
     ASSERT_EQ(v[1].value, it[-1].value);
 }
 
+TEST_F(persistent_vector_test, iterators_should_walk_forwards_and_backwards_across_leaves)
+{
+    auto n = numbers(4 * 4 * 4 + 3);
+    string_vector v{begin(n), end(n)};
+    std::size_t i = 0;
+    for (auto it = v.begin(); it != v.end(); ++it, ++i)
+        ASSERT_EQ(n[i].value, it->value) << "index " << i;
+    for (auto it = v.end(); it != v.begin(); --i)
+        ASSERT_EQ(n[i - 1].value, (--it)->value) << "index " << i;
+    auto it = v.begin() + 5;
+    ASSERT_EQ(n[5].value, it->value);
+    ASSERT_EQ(n[1].value, it[-4].value);
+    ASSERT_EQ(n[66].value, it[61].value);
+    ASSERT_EQ(n[2].value, (it - 3)->value);
+}
+
+TEST_F(persistent_vector_test, for_each_chunk_should_visit_all_elements_in_order)
+{
+    for (unsigned size : {0u, 1u, 4u, 5u, 16u, 17u, 4u * 4u * 4u + 3u})
+    {
+        auto n = numbers(size);
+        string_vector v{begin(n), end(n)};
+        std::vector<std::string> visited;
+        v.for_each_chunk([&](auto first, auto last)
+        {
+            ASSERT_GT(last - first, 0);
+            ASSERT_LE(last - first, 4);
+            for (; first != last; ++first)
+                visited.push_back(first->value);
+        });
+        ASSERT_EQ(size, visited.size());
+        for (std::size_t i = 0; i < size; ++i)
+            ASSERT_EQ(n[i].value, visited[i]) << "size " << size << " index " << i;
+    }
+}
+
+TEST_F(persistent_vector_test, should_compare_vectors_sharing_leaves)
+{
+    auto n = numbers(4 * 4 + 2);
+    string_vector v{begin(n), end(n)};
+    auto w = v.push_back(s("x"));
+    EXPECT_TRUE(v == w.pop_back());
+    EXPECT_FALSE(v.push_back(s("y")) == w);
+    EXPECT_TRUE(v.pop_back().push_back(n.back()) == v);
+}
+
 TEST_F(persistent_vector_test, pop_back_should_remove_one_element_from_the_end)
 {
     auto n = numbers(4 * 4 * 4 * 4 * 4);
@@ -236,6 +341,38 @@ TEST_F(persistent_vector_test, pop_back_should_remove_one_element_from_the_end)
     }
 }
 
+TEST_F(persistent_vector_test, push_back_should_not_modify_vectors_sharing_the_same_tail)
+{
+    auto n = numbers(4 * 4 * 4 + 3);
+    for (std::size_t size = 0; size < n.size() - 2; ++size)
+    {
+        auto v = string_vector{begin(n), begin(n) + size};
+        auto a = v.push_back(n[size + 1]);
+        auto b = v.push_back(n[size + 2]);
+        ASSERT_EQ(size, v.size());
+        ASSERT_EQ(n[size + 1].value, a.back().value) << "size " << size;
+        ASSERT_EQ(n[size + 2].value, b.back().value) << "size " << size;
+        for (std::size_t k = 0; k < size; ++k)
+        {
+            ASSERT_EQ(n[k].value, a[k].value) << "index " << k;
+            ASSERT_EQ(n[k].value, b[k].value) << "index " << k;
+        }
+    }
+}
+
+TEST_F(persistent_vector_test, push_back_should_append_after_pop_back)
+{
+    auto n = numbers(4 * 4 * 4 + 1);
+    auto v = string_vector{begin(n), end(n)};
+    for (std::size_t size = n.size(); size > 0; --size)
+    {
+        auto popped = v.pop_back();
+        auto pushed = popped.push_back(n[size - 1]);
+        ASSERT_TRUE(pushed == v) << "size " << size;
+        v = popped;
+    }
+}
+
 TEST_F(persistent_vector_test, should_be_equality_comparable)
 {
     EXPECT_TRUE(string_vector{} == string_vector{});
@@ -251,4 +388,140 @@ TEST_F(persistent_vector_test, should_be_equality_comparable)
     EXPECT_TRUE((string_vector{s("7"), s("2"), s("3")} != string_vector{s("1"), s("2"), s("3")}));
 }
 
+TEST_F(persistent_vector_test, slice_should_return_the_elements_in_a_given_range)
+{
+    auto n = numbers(4 * 4 * 4 + 6);
+    string_vector v{begin(n), end(n)};
+    for (std::size_t first = 0; first <= n.size(); ++first)
+        for (std::size_t last = first; last <= n.size(); ++last)
+        {
+            auto s = v.slice(first, last);
+            ASSERT_EQ(last - first, s.size());
+            ASSERT_EQ(values(n, first, last), values(s)) << "slice " << first << " " << last;
+            assert_indexable(s);
+        }
+    EXPECT_THROW(v.slice(2, 1), std::out_of_range);
+    EXPECT_THROW(v.slice(0, n.size() + 1), std::out_of_range);
+}
+
+TEST_F(persistent_vector_test, cached_fold_should_fold_all_elements_in_order_whatever_the_tree_shape)
+{
+    auto n = numbers(4 * 4 * 4 + 6);
+    auto combine = [](std::size_t h, const traced_string& e) { return h * 31 + std::stoul(e.value); };
+    auto expected = [&](std::size_t first, std::size_t last)
+    {
+        std::size_t h = 7;
+        for (auto i = first; i < last; ++i)
+            h = combine(h, n[i]);
+        return h;
+    };
+    string_vector v{begin(n), end(n)};
+    ASSERT_EQ(expected(0, n.size()), v.cached_fold(7, combine));
+    ASSERT_EQ(expected(0, n.size()), v.cached_fold(7, combine));
+    ASSERT_EQ(expected(0, n.size() - 1), v.pop_back().cached_fold(7, combine));
+    ASSERT_EQ(expected(0, n.size()), v.pop_back().push_back(n.back()).cached_fold(7, combine));
+    for (std::size_t first = 0; first <= n.size(); first += 3)
+        for (std::size_t last = first; last <= n.size(); last += 5)
+            ASSERT_EQ(expected(first, last), v.slice(first, last).cached_fold(7, combine)) << "slice " << first << " " << last;
+    for (std::size_t split = 0; split <= n.size(); ++split)
+        ASSERT_EQ(expected(0, n.size()), v.slice(0, split).concat(v.slice(split, n.size())).cached_fold(7, combine)) << "split " << split;
+}
+
+TEST_F(persistent_vector_test, slices_should_support_push_back_and_pop_back)
+{
+    auto n = numbers(4 * 4 * 4 + 6);
+    string_vector v{begin(n), end(n)};
+    auto s = v.slice(3, 50);
+    for (std::size_t i = 50; i < n.size(); ++i)
+        s = s.push_back(n[i]);
+    ASSERT_EQ(values(n, 3, n.size()), values(s));
+    assert_indexable(s);
+    for (auto size = s.size(); size > 0; --size)
+    {
+        s = s.pop_back();
+        ASSERT_EQ(values(n, 3, 3 + size - 1), values(s)) << "size " << size;
+    }
+}
+
+TEST_F(persistent_vector_test, concat_should_append_all_elements_of_another_vector)
+{
+    auto n = numbers(2 * (4 * 4 * 4 + 6));
+    std::vector<std::size_t> sizes{0, 1, 3, 4, 5, 16, 17, 20, 63, 64, 65, 70};
+    for (auto left_size : sizes)
+        for (auto right_size : sizes)
+        {
+            string_vector left{begin(n), begin(n) + left_size};
+            string_vector right{begin(n) + left_size, begin(n) + left_size + right_size};
+            auto c = left.concat(right);
+            ASSERT_EQ(left_size + right_size, c.size());
+            ASSERT_EQ(values(n, 0, left_size + right_size), values(c)) << "sizes " << left_size << " " << right_size;
+            assert_indexable(c);
+        }
+}
+
+TEST_F(persistent_vector_test, concat_should_keep_vectors_searchable_after_many_small_concatenations)
+{
+    auto n = numbers(4 * 4 * 4 * 4 + 7);
+    string_vector v;
+    for (std::size_t first = 0, size = 1; first < n.size(); first += size, size = size % 7 + 1)
+    {
+        auto last = std::min(first + size, n.size());
+        v = v.concat(string_vector{begin(n) + first, begin(n) + last}.push_back(n[0]).pop_back());
+        v = v.slice(0, v.size()).concat({});
+    }
+    ASSERT_EQ(values(n, 0, n.size()), values(v));
+    assert_indexable(v);
+    auto mixed = v.slice(5, 200).concat(v.slice(1, 100)).concat(v.slice(150, n.size()));
+    auto expected = values(n, 5, 200);
+    auto middle = values(n, 1, 100);
+    auto end = values(n, 150, n.size());
+    expected.insert(expected.end(), middle.begin(), middle.end());
+    expected.insert(expected.end(), end.begin(), end.end());
+    ASSERT_EQ(expected, values(mixed));
+    assert_indexable(mixed);
+}
+
+TEST_F(persistent_vector_test, insert_should_add_elements_at_a_given_position)
+{
+    auto n = numbers(4 * 4 + 3);
+    string_vector v{begin(n), end(n)};
+    for (std::size_t i = 0; i <= n.size(); ++i)
+    {
+        auto expected = values(v);
+        expected.insert(expected.begin() + i, "x");
+        ASSERT_EQ(expected, values(v.insert(v.begin() + i, s("x")))) << "index " << i;
+        auto extra = numbers(6);
+        expected = values(v);
+        expected.insert(expected.begin() + i, {"1", "2", "3", "4", "5", "6"});
+        ASSERT_EQ(expected, values(v.insert(v.begin() + i, begin(extra), end(extra)))) << "index " << i;
+    }
+}
+
+TEST_F(persistent_vector_test, erase_should_remove_elements_from_a_given_range)
+{
+    auto n = numbers(4 * 4 + 3);
+    string_vector v{begin(n), end(n)};
+    for (std::size_t i = 0; i < n.size(); ++i)
+    {
+        auto expected = values(v);
+        expected.erase(expected.begin() + i);
+        ASSERT_EQ(expected, values(v.erase(v.begin() + i))) << "index " << i;
+        for (std::size_t j = i; j <= n.size(); ++j)
+        {
+            expected = values(v);
+            expected.erase(expected.begin() + i, expected.begin() + j);
+            ASSERT_EQ(expected, values(v.erase(v.begin() + i, v.begin() + j))) << "range " << i << " " << j;
+        }
+    }
+}
+
+TEST_F(persistent_vector_test, slices_and_concatenations_should_compare_equal_to_built_vectors)
+{
+    auto n = numbers(4 * 4 * 4 + 6);
+    string_vector v{begin(n), end(n)};
+    EXPECT_TRUE(v.slice(0, 10).concat(v.slice(10, n.size())) == v);
+    EXPECT_TRUE(v.slice(7, 33) == (string_vector{begin(n) + 7, begin(n) + 33}));
+    EXPECT_FALSE(v.slice(7, 33) == (string_vector{begin(n) + 8, begin(n) + 34}));
+}
+
 }
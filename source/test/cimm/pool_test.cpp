@@ -0,0 +1,97 @@
+#include <gtest/gtest.h>
+#include <cimm/pool.hpp>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
+namespace cimm
+{
+
+TEST(pool_test, size_classes_should_be_multiples_of_max_alignment)
+{
+    auto a = alignof(std::max_align_t);
+    ASSERT_EQ(a, detail::pool_size_class(1));
+    ASSERT_EQ(a, detail::pool_size_class(a));
+    ASSERT_EQ(2 * a, detail::pool_size_class(a + 1));
+}
+
+TEST(pool_test, should_allocate_distinct_aligned_blocks)
+{
+    using pool = detail::fixed_size_pool<32>;
+    std::set<void *> blocks;
+    for (int i = 0; i < 5000; ++i)
+    {
+        auto b = pool::allocate();
+        ASSERT_EQ(0u, reinterpret_cast<std::uintptr_t>(b) % alignof(std::max_align_t));
+        ASSERT_TRUE(blocks.insert(b).second);
+    }
+    for (auto b : blocks)
+        pool::deallocate(b);
+}
+
+TEST(pool_test, should_reuse_deallocated_blocks)
+{
+    using pool = detail::fixed_size_pool<48>;
+    auto b = pool::allocate();
+    pool::deallocate(b);
+    ASSERT_EQ(b, pool::allocate());
+    pool::deallocate(b);
+}
+
+TEST(pool_test, should_keep_blocks_valid_after_the_allocating_thread_exits)
+{
+    using pool = detail::fixed_size_pool<64>;
+    void *b = nullptr;
+    std::thread([&] { b = pool::allocate(); }).join();
+    *static_cast<int *>(b) = 7;
+    ASSERT_EQ(7, *static_cast<int *>(b));
+    pool::deallocate(b);
+}
+
+TEST(pool_test, should_reuse_blocks_freed_by_another_thread)
+{
+    using pool = detail::fixed_size_pool<80>;
+    const int rounds = 500, batch_size = 1000, max_queued = 4;
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::deque<std::vector<void *>> queue;
+    std::set<void *> seen;
+
+    std::thread producer([&]
+    {
+        for (int i = 0; i < rounds; ++i)
+        {
+            std::vector<void *> batch;
+            for (int j = 0; j < batch_size; ++j)
+                batch.push_back(pool::allocate());
+            std::unique_lock<std::mutex> lock(mutex);
+            changed.wait(lock, [&] { return queue.size() < max_queued; });
+            queue.push_back(std::move(batch));
+            changed.notify_all();
+        }
+    });
+    std::thread consumer([&]
+    {
+        for (int i = 0; i < rounds; ++i)
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            changed.wait(lock, [&] { return !queue.empty(); });
+            auto batch = std::move(queue.front());
+            queue.pop_front();
+            changed.notify_all();
+            lock.unlock();
+            seen.insert(begin(batch), end(batch));
+            for (auto b : batch)
+                pool::deallocate(b);
+        }
+    });
+    producer.join();
+    consumer.join();
+
+    ASSERT_LT(seen.size(), 20000u);
+}
+
+}
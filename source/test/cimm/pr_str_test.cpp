@@ -1,6 +1,7 @@
 #include <gtest/gtest.h>
 #include <cimm/str.hpp>
 #include <cimm/expression.hpp>
+#include <limits>
 
 namespace cimm
 {
@@ -15,6 +16,8 @@ TEST(pr_str_test, should_convert_the_given_integer_to_a_string)
     EXPECT_EQ(string("0"), pr_str(expression(integer(0))));
     EXPECT_EQ(string("31902"), pr_str(expression(integer(31902))));
     EXPECT_EQ(string("-78"), pr_str(expression(integer(-78))));
+    EXPECT_EQ(string("2147483647"), pr_str(expression(std::numeric_limits<integer>::max())));
+    EXPECT_EQ(string("-2147483648"), pr_str(expression(std::numeric_limits<integer>::min())));
 }
 
 TEST(pr_str_test, should_convert_an_empty_list_to_a_pair_of_parens)
@@ -82,6 +85,22 @@ TEST(pr_str_test, should_quote_strings_in_vectors)
     EXPECT_EQ(string("[\"abc\"]"), pr_str(expression{vector{string{"abc"}}}));
 }
 
+TEST(pr_str_test, should_convert_a_map_to_key_value_pairs_separated_by_commas_inside_braces)
+{
+    EXPECT_EQ(string("{}"), pr_str(expression(hash_map{})));
+    EXPECT_EQ(string("{:a \"b\"}"), pr_str(expression(hash_map{{keyword("a"), string("b")}})));
+    auto two = pr_str(expression(hash_map{{integer(1), integer(2)}, {integer(3), integer(4)}}));
+    EXPECT_TRUE(two == string("{1 2, 3 4}") || two == string("{3 4, 1 2}")) << two;
+}
+
+TEST(pr_str_test, should_convert_a_set_to_elements_separated_by_single_space_inside_hash_braces)
+{
+    EXPECT_EQ(string("#{}"), pr_str(expression(hash_set{})));
+    EXPECT_EQ(string("#{\"b\"}"), pr_str(expression(hash_set{string("b")})));
+    auto two = pr_str(expression(hash_set{integer(1), integer(2)}));
+    EXPECT_TRUE(two == string("#{1 2}") || two == string("#{2 1}")) << two;
+}
+
 TEST(pr_str_test, should_quote_strings_in_lists)
 {
     EXPECT_EQ(string("(\"abc\")"), pr_str(expression{list{string{"abc"}}}));
@@ -105,4 +124,21 @@ TEST(pr_str_test, should_convert_errors)
     EXPECT_EQ(string{"error: 7"}, pr_str(error{expression{integer(7)}}));
 }
 
+TEST(pr_str_test, should_convert_values_nested_in_collections)
+{
+    EXPECT_EQ(string("[:a (1 \"b\") error: -2]"), pr_str(expression(vector{keyword("a"), list{integer(1), string("b")}, error{expression{integer(-2)}}})));
+}
+
+TEST(pr_str_test, should_convert_deeply_nested_collections)
+{
+    expression e{vector{}};
+    std::string expected = "[]";
+    for (integer i = 0; i < 1000; ++i)
+    {
+        e = vector{integer(i), e};
+        expected = "[" + std::to_string(i) + " " + expected + "]";
+    }
+    EXPECT_EQ(string(expected), pr_str(e));
+}
+
 }
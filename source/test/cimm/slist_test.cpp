@@ -90,4 +90,58 @@ TEST(slist_test, should_provide_map_with_a_function)
     ASSERT_TRUE(slist{integer(12)}.cons(integer(5)).cons(integer(3)) == slist{integer(5)}.cons(integer(-2)).cons(integer(-4)).map(add7));
 }
 
+TEST(slist_test, should_keep_shared_tails_alive)
+{
+    auto tail = slist{integer(1)}.cons(integer(2));
+    auto l1 = tail.cons(integer(3));
+    auto l2 = tail.cons(integer(4));
+    tail = slist{};
+    l1 = slist{};
+    ASSERT_EQ(3, l2.count());
+    ASSERT_EQ(integer(4), l2.first());
+    ASSERT_EQ(integer(2), l2.next().first());
+    ASSERT_EQ(integer(1), l2.next().next().first());
+}
+
+TEST(slist_test, map_should_release_mapped_elements_when_the_function_throws)
+{
+    auto l = slist{integer(1)}.cons(integer(2)).cons(integer(3));
+    auto calls = 0;
+    ASSERT_THROW(l.map([&](const expression& e) { if (++calls == 3) throw std::runtime_error("failed"); return e; }), std::runtime_error);
+    ASSERT_EQ(3, calls);
+}
+
+namespace
+{
+
+const integer long_list_size = 10000000;
+
+auto make_long_list(integer last)
+{
+    slist l;
+    for (integer i = 0; i < long_list_size; ++i)
+        l = l.cons(i == 0 ? last : i);
+    return l;
+}
+
+}
+
+TEST(slist_test, should_compare_long_lists_without_recursion)
+{
+    auto l1 = make_long_list(0);
+    ASSERT_TRUE(l1 == make_long_list(0));
+    ASSERT_FALSE(l1 == make_long_list(-1));
+    ASSERT_TRUE(l1 == l1);
+}
+
+TEST(slist_test, should_release_long_lists_without_recursion)
+{
+    auto l = make_long_list(0);
+    auto shared_tail = l.next();
+    l = slist{};
+    ASSERT_EQ(long_list_size - 1, shared_tail.count());
+    shared_tail = slist{};
+    ASSERT_EQ(0, shared_tail.count());
+}
+
 }
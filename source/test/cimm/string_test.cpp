@@ -0,0 +1,102 @@
+#include <gtest/gtest.h>
+#include <cimm/string.hpp>
+#include <sstream>
+#include <unordered_set>
+
+namespace cimm
+{
+
+namespace
+{
+
+auto text(const string& s)
+{
+    return std::string(begin(s), end(s));
+}
+
+}
+
+TEST(string_test, should_be_empty_by_default)
+{
+    string s;
+    EXPECT_EQ(0u, s.size());
+    EXPECT_STREQ("", s.c_str());
+    EXPECT_EQ(string(""), s);
+    EXPECT_EQ(string("").std_hash(), s.std_hash());
+}
+
+TEST(string_test, should_store_short_and_long_text)
+{
+    for (std::size_t n : {1, 15, 16, 100})
+    {
+        std::string chars(n, 'x');
+        string s(chars);
+        EXPECT_EQ(n, s.size());
+        EXPECT_EQ(chars, text(s));
+        EXPECT_EQ(chars, s.c_str());
+    }
+}
+
+TEST(string_test, should_keep_embedded_nul_characters)
+{
+    string s(std::string("a\0b", 3));
+    EXPECT_EQ(3u, s.size());
+    EXPECT_NE(string("a"), s);
+}
+
+TEST(string_test, copies_should_share_long_text)
+{
+    string s(std::string(100, 'x'));
+    auto copy = s;
+    EXPECT_EQ(s.c_str(), copy.c_str());
+    EXPECT_EQ(s, copy);
+}
+
+TEST(string_test, should_leave_moved_from_strings_empty)
+{
+    for (std::size_t n : {3, 100})
+    {
+        string s(std::string(n, 'x'));
+        auto moved = std::move(s);
+        EXPECT_EQ(string(), s);
+        EXPECT_EQ(n, moved.size());
+        s = moved;
+        EXPECT_EQ(moved, s);
+    }
+}
+
+TEST(string_test, should_compare_by_value)
+{
+    EXPECT_EQ(string("abc"), string(std::string("abc")));
+    EXPECT_NE(string("abc"), string("abd"));
+    EXPECT_NE(string("abc"), string("abcd"));
+    EXPECT_EQ(string(std::string(40, 'y')), string(std::string(40, 'y')));
+    EXPECT_NE(string(std::string(40, 'y')), string(std::string(40, 'y') + 'z'));
+}
+
+TEST(string_test, should_hash_equal_strings_equally)
+{
+    EXPECT_EQ(string("abc").std_hash(), string(std::string("abc")).std_hash());
+    EXPECT_EQ((string("ab") + 'c').std_hash(), string("abc").std_hash());
+    EXPECT_NE(string("abc").std_hash(), string("abd").std_hash());
+    std::unordered_set<string> set{"a", "b", string(std::string(30, 'c'))};
+    EXPECT_EQ(1u, set.count(string(std::string(30, 'c'))));
+    EXPECT_EQ(0u, set.count("c"));
+}
+
+TEST(string_test, should_concatenate)
+{
+    EXPECT_EQ(string("abcd"), string("ab") + string("cd"));
+    EXPECT_EQ(string("xab"), 'x' + string("ab"));
+    EXPECT_EQ(string("abx"), string("ab") + 'x');
+    EXPECT_EQ(string(std::string(20, 'a') + "b"), string(std::string(10, 'a')) + string(std::string(10, 'a') + "b"));
+}
+
+TEST(string_test, should_write_to_streams)
+{
+    std::ostringstream os;
+    os << string("abc") << string(std::string(20, 'd'));
+    EXPECT_EQ("abc" + std::string(20, 'd'), os.str());
+}
+
+}
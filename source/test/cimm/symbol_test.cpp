@@ -22,6 +22,15 @@ TEST_F(symbol_test, should_make_symbols_from_the_first_parameter_only)
     EXPECT_EQ(expression(symbol("a")), evaluate(list{symbol("symbol"), string("a"), string("b")}));
 }
 
+TEST_F(symbol_test, should_be_interned)
+{
+    EXPECT_EQ(sizeof(void *), sizeof(symbol));
+    EXPECT_EQ(symbol("abc"), symbol(std::string("ab") + "c"));
+    EXPECT_EQ(&pr_str(symbol("abc")), &pr_str(symbol(std::string("ab") + "c")));
+    EXPECT_EQ(std::hash<symbol>()(symbol("abc")), std::hash<symbol>()(symbol(std::string("ab") + "c")));
+    EXPECT_FALSE(symbol("abc") == symbol("abd"));
+}
+
 TEST_F(symbol_test, should_fail_for_no_parameters)
 {
     assert_arity_error(0, "symbol", "(symbol)");
@@ -5,6 +5,21 @@
 namespace cimm
 {
 
+namespace
+{
+
+struct copy_counted
+{
+    static int copies;
+    int value;
+    copy_counted(int value) : value(value) { }
+    copy_counted(const copy_counted& other) : value(other.value) { ++copies; }
+};
+
+int copy_counted::copies = 0;
+
+}
+
 struct transient_vector_test : testing::Test
 {
     struct traced_string
@@ -244,4 +259,85 @@ TEST_F(transient_vector_test, should_be_equality_comparable)
     EXPECT_TRUE((string_vector{s("7"), s("2"), s("3")} != string_vector{s("1"), s("2"), s("3")}));
 }
 
+TEST_F(transient_vector_test, push_back_should_not_copy_the_existing_elements)
+{
+    copy_counted::copies = 0;
+    transient_vector<copy_counted, 2> v;
+    for (int i = 0; i < 4 * 4 * 4 * 4; ++i)
+        v.push_back(copy_counted{i});
+    EXPECT_EQ(4 * 4 * 4 * 4, copy_counted::copies);
+    for (int i = 0; i < 4 * 4 * 4 * 4; ++i)
+        ASSERT_EQ(i, v[i].value);
+}
+
+TEST_F(transient_vector_test, persistent_should_return_a_vector_with_the_same_elements)
+{
+    auto n = numbers(4 * 4 * 4 + 1);
+    for (std::size_t size = 0; size <= n.size(); ++size)
+    {
+        string_vector t{begin(n), begin(n) + size};
+        auto v = std::move(t).persistent();
+        ASSERT_EQ(size, v.size());
+        for (std::size_t k = 0; k < size; ++k)
+            ASSERT_EQ(n[k].value, v[k].value) << "index " << k;
+    }
+}
+
+TEST_F(transient_vector_test, should_not_modify_the_persistent_vector_it_was_created_from)
+{
+    auto n = numbers(4 * 4 * 4 + 1);
+    auto original = persistent_vector<traced_string, 2>{begin(n), end(n)};
+    string_vector t{original};
+    t.pop_back();
+    t.pop_back();
+    t.push_back(s("x"));
+    for (std::size_t i = 0; i < 4 * 4 + 3; ++i)
+        t.pop_back();
+    for (std::size_t i = 0; i < 4 * 4; ++i)
+        t.push_back(s("y"));
+    auto modified = std::move(t).persistent();
+    ASSERT_EQ(n.size(), original.size());
+    for (std::size_t k = 0; k < n.size(); ++k)
+        ASSERT_EQ(n[k].value, original[k].value) << "index " << k;
+    ASSERT_EQ(n.size() - 4, modified.size());
+    ASSERT_EQ("y", modified.back().value);
+    ASSERT_EQ(n[n.size() - 4 * 4 - 5].value, modified[n.size() - 4 * 4 - 5].value);
+}
+
+TEST_F(transient_vector_test, should_not_modify_vectors_returned_by_persistent_earlier)
+{
+    auto n = numbers(4 * 4 + 2);
+    string_vector t{begin(n), end(n)};
+    auto frozen = std::move(t).persistent();
+    string_vector again{frozen};
+    again.pop_back();
+    again.push_back(s("x"));
+    again.push_back(s("y"));
+    ASSERT_EQ(n.size(), frozen.size());
+    ASSERT_EQ(n.back().value, frozen.back().value);
+    ASSERT_EQ("y", std::move(again).persistent().back().value);
+}
+
+TEST_F(transient_vector_test, should_push_and_pop_on_a_concatenated_persistent_vector)
+{
+    auto n = numbers(4 * 4 * 4 + 9);
+    auto left = persistent_vector<traced_string, 2>{begin(n), begin(n) + 11};
+    auto right = persistent_vector<traced_string, 2>{begin(n) + 11, end(n)};
+    auto joined = left.slice(0, 11).concat(right.slice(0, right.size() - 3));
+    string_vector t{joined};
+    for (std::size_t i = n.size() - 3; i < n.size(); ++i)
+        t.push_back(n[i]);
+    ASSERT_EQ(n.size(), t.size());
+    for (std::size_t k = 0; k < n.size(); ++k)
+        ASSERT_EQ(n[k].value, t[k].value) << "index " << k;
+    for (auto size = n.size(); size > 1; --size)
+    {
+        t.pop_back();
+        ASSERT_EQ(n[size - 2].value, t.back().value) << "size " << size;
+    }
+    ASSERT_EQ(n.size() - 3, joined.size());
+    ASSERT_EQ(n[n.size() - 4].value, joined.back().value);
 }
+
+}
+
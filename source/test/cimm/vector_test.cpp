@@ -1,4 +1,5 @@
 #include "eval_test.hpp"
+#include <cimm/error.hpp>
 #include <cimm/type_error.hpp>
 
 namespace cimm
@@ -49,6 +50,15 @@ TEST_F(vector_test, nth_provide_the_value_at_a_given_index)
     EXPECT_EQ(parse("7"), evaluate_parsed("(nth [5 2 7] 2)"));
 }
 
+TEST_F(vector_test, nth_should_fail_for_an_index_out_of_bounds)
+{
+    assert_evaluation_error<index_out_of_bounds_error>("index 0 out of bounds for count 0", "(nth [] 0)");
+    assert_evaluation_error<index_out_of_bounds_error>("index 3 out of bounds for count 3", "(nth [5 2 7] 3)");
+    assert_evaluation_error<index_out_of_bounds_error>("index 40 out of bounds for count 3", "(nth [5 2 7] 40)");
+    assert_evaluation_error<index_out_of_bounds_error>("index 100 out of bounds for count 3", "(nth [5 2 7] 100)");
+    assert_evaluation_error<index_out_of_bounds_error>("index -1 out of bounds for count 3", "(nth [5 2 7] -1)");
+}
+
 TEST_F(vector_test, count_should_return_the_number_of_elements)
 {
     EXPECT_EQ(parse("0"), evaluate_parsed("(count [])"));
@@ -56,4 +66,34 @@ TEST_F(vector_test, count_should_return_the_number_of_elements)
     EXPECT_EQ(parse("3"), evaluate_parsed("(count [5 2 7])"));
 }
 
+TEST_F(vector_test, subvec_should_return_the_elements_in_a_given_range)
+{
+    EXPECT_EQ(parse("[]"), evaluate_parsed("(subvec [] 0)"));
+    EXPECT_EQ(parse("[2 7]"), evaluate_parsed("(subvec [5 2 7] 1)"));
+    EXPECT_EQ(parse("[5 2]"), evaluate_parsed("(subvec [5 2 7] 0 2)"));
+    EXPECT_EQ(parse("[]"), evaluate_parsed("(subvec [5 2 7] 3)"));
+}
+
+TEST_F(vector_test, subvec_should_fail_when_indices_are_out_of_bounds)
+{
+    assert_evaluation_error<index_out_of_bounds_error>("index 4 out of bounds for count 3", "(subvec [5 2 7] 4)");
+    assert_evaluation_error<index_out_of_bounds_error>("index 1 out of bounds for count 3", "(subvec [5 2 7] 2 1)");
+    assert_evaluation_error<index_out_of_bounds_error>("index -1 out of bounds for count 3", "(subvec [5 2 7] -1)");
+}
+
+TEST_F(vector_test, catvec_should_concatenate_vectors)
+{
+    EXPECT_EQ(parse("[]"), evaluate_parsed("(catvec)"));
+    EXPECT_EQ(parse("[5 2 7]"), evaluate_parsed("(catvec [5] [] [2 7])"));
+    EXPECT_EQ(parse("[1 2 3 4]"), evaluate_parsed("(catvec (subvec [0 1 2] 1) [3 4])"));
+}
+
+TEST_F(vector_test, subvec_should_repeatedly_drop_the_first_element_of_a_large_vector)
+{
+    EXPECT_EQ(parse("5000"), evaluate_parsed(
+        "(loop [v (loop [v [] i 0] (if (= i 5000) v (recur (conj v i) (+ i 1)))) n 0]"
+        "  (if (= (count v) 0) n (recur (subvec v 1) (+ n 1))))"));
+}
+
 }
+
@@ -1,9 +1,16 @@
 #include <gmock/gmock.h>
 #include "test_listener.hpp"
+#include "cimm/eval_test.hpp"
+#include <cstring>
 
 int main(int argc, char **argv)
 {
     testing::InitGoogleMock(&argc, argv);
+    for (int i = 1; i < argc; ++i)
+        if (std::strcmp(argv[i], "--engine=compile") == 0)
+            cimm::test_engine() = cimm::evaluate_compiled;
+        else if (std::strcmp(argv[i], "--engine=vm") == 0)
+            cimm::test_engine() = cimm::evaluate_bytecode;
     testing::UnitTest& unitTest = *testing::UnitTest::GetInstance();
     testing::TestEventListeners& listeners = unitTest.listeners();
     delete listeners.Release(listeners.default_result_printer());